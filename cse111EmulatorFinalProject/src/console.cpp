@@ -18,16 +18,35 @@
 #define CONTROLLER_LEFT_MASK ((uint8_t)0x02)
 #define CONTROLLER_RIGHT_MASK ((uint8_t)0x01)
 
-Console::Console(const std::string &filename,
+Console::Console(const std::string &filename, ProfileId profile,
                  const std::vector<std::string> &allowed_extensions)
     : filename_(filename),
       RAM_(0x8000 + 0x8000, 0),
+      memory_(makeMemoryController(profile, RAM_)),
       CPU_(*this, RAM_),
       GPU_(*this, RAM_) {
+  open(allowed_extensions);
+}
+
+Console::Console(const std::string &filename, const HeadlessIO &io,
+                 ProfileId profile)
+    : headless_(true),
+      in_(&io.in),
+      out_(&io.out),
+      err_(&io.err),
+      filename_(filename),
+      RAM_(0x8000 + 0x8000, 0),
+      memory_(makeMemoryController(profile, RAM_)),
+      CPU_(*this, RAM_),
+      GPU_(*this, RAM_) {
+  open({".slug"});
+}
+
+void Console::open(const std::vector<std::string> &allowed_extensions) {
   bool valid_extension = 0;
   valid_extension |= (allowed_extensions.size() == 0);
   for (const auto &extension : allowed_extensions) {
-    valid_extension |= hasExtension(filename, extension);
+    valid_extension |= hasExtension(filename_, extension);
   }
   if (!valid_extension) {
     std::cerr << "Unsupported file extension." << std::endl;
@@ -35,11 +54,11 @@ Console::Console(const std::string &filename,
   }
 
   // Open slug file
-  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  std::ifstream file(filename_, std::ios::binary | std::ios::ate);
 
   // Check if file is opened successfully
   if (!file.is_open()) {
-    std::cerr << "Error opening file: " << filename << std::endl;
+    std::cerr << "Error opening file: " << filename_ << std::endl;
     exit(1);
   }
 
@@ -58,8 +77,18 @@ Console::Console(const std::string &filename,
   // Close the file
   file.close();
 
-  // First fill RAM with .slugFile
-  std::memcpy(RAM_.data() + 0x8000, contents_.get(), file_size_);
+  // First map the .slugFile into the SLUG address space
+  if (!memory_->load(contents_.get(), file_size_)) {
+    std::cerr << "ROM is too large for the " << memory_->name()
+              << " profile: " << filename_ << std::endl;
+    exit(1);
+  }
+
+  // Native code for this ROM, if recompile output was linked in. Only valid
+  // while the code under it can't be banked out.
+  if (memory_->fixedROM()) {
+    recompiled_ = findRecompiledRom(contents_.get(), file_size_);
+  }
 }
 
 bool Console::hasExtension(const std::string &filename,
@@ -72,27 +101,46 @@ bool Console::hasExtension(const std::string &filename,
 void Console::reset() {  // Reset Sequence
   // 1. Clear all of RAM with zeros
   std::fill(RAM_.begin(), RAM_.begin() + kRAMSize, 0);
+  memory_->clearVRAM();
 
   // 2. Copy data section to RAM
   std::memcpy(RAM_.data(), &RAM_[read32(kLoadDataAddress)],
               read32(kDataSizeAddress));
 
   // 3. Initialize stack pointer register to the end of the stack (0x5200)
-  CPU_.registers_[29] = kVRAMAddress;
+  CPU_.state_.registers[29] = kVRAMAddress;
 
   // 4. Call setup()
   setup();
 
+  if (headless_) {  // Run loop() back to back until the ROM halts
+    while (CPU_.state_.PC == 0x0000 && !CPU_.state_.halted &&
+           frame_index_ < frame_limit_) {
+      ++frame_index_;
+      loop();
+    }
+    return;
+  }
+
   // Use high-resolution clock for accurate timing
   using namespace std::chrono;  // Limited scope for chrono
   high_resolution_clock::time_point start_time = high_resolution_clock::now();
-  high_resolution_clock::time_point frame_start;
+  high_resolution_clock::time_point frame_start = start_time;
+  high_resolution_clock::duration frame_length;
   int frame_count = 0;
   double elapsed_seconds = 0.0;
 
   // 5. Begin Game Loop Sequence
-  while (CPU_.PC_ == 0x0000 && event_.type != SDL_QUIT) {
+  while (CPU_.state_.PC == 0x0000 && !CPU_.state_.halted &&
+         event_.type != SDL_QUIT) {
+    frame_length = duration_cast<high_resolution_clock::duration>(
+        duration<double>(frame_time_));
+    if (low_latency_) {
+      // Sleep first so input is polled right before loop() reads it
+      std::this_thread::sleep_until(frame_start + frame_length);
+    }
     frame_start = high_resolution_clock::now();
+    ++frame_index_;
 
     controllerInput();
     if (!paused_) {
@@ -119,45 +167,72 @@ void Console::reset() {  // Reset Sequence
     }
 
     // Limit FPS using sleep (more accurate than SDL_Delay)
-    double remaining_time =
-        frame_time_ - duration_cast<duration<double>>(
-                          high_resolution_clock::now() - frame_start)
-                          .count();
-    if (remaining_time > 0.0) {
-      std::this_thread::sleep_for(duration<double>(remaining_time));
+    if (!low_latency_) {
+      std::this_thread::sleep_until(frame_start + frame_length);
     }
   }
+
+  input_latency_.report(out());
 }
 
 void Console::setup() {
-  CPU_.immediate_ = read32(kSetupAddress) / 4;
-  CPU_.PC_ = 0xfffc;
-  CPU_.JAL();
-  while (CPU_.PC_ >= 0x8000) {
-    CPU_.ExecuteInstruction(read32(CPU_.PC_));
-  }  // Stops when PC wraps back to 0
-  CPU_.registers_[29] = kVRAMAddress;
+  CPU_.call(read32(kSetupAddress) / 4);
+  execute();
+  CPU_.state_.registers[29] = kVRAMAddress;
 }
 
 void Console::loop() {
-  CPU_.immediate_ = read32(kLoopAddress) / 4;
-  CPU_.PC_ = 0xfffc;
-  CPU_.JAL();
-  while (CPU_.PC_ >= 0x8000) {
-    CPU_.ExecuteInstruction(read32(CPU_.PC_));
+  CPU_.call(read32(kLoopAddress) / 4);
+  execute();
+  CPU_.state_.registers[29] = kVRAMAddress;
+}
+
+void Console::execute() {
+  // Pick the core once per call so the fast path has no debugger checks
+  if (debugger_.armed()) {
+    run<true>();
+  } else if (recompiled_) {
+    runRecompiled();
+  } else {
+    run<false>();
+  }
+}
+
+template <bool kDebug>
+void Console::run() {
+  while (CPU_.state_.PC >= 0x8000 && !CPU_.state_.halted) {
+    uint32_t instruction = read32(CPU_.state_.PC);
+    if constexpr (kDebug) {
+      debugger_.check(*this, CPU_, instruction);
+    }
+    CPU_.ExecuteInstruction(instruction);
   }  // Stops when PC wraps back to 0
-  CPU_.registers_[29] = kVRAMAddress;
+}
+
+void Console::runRecompiled() {
+  while (CPU_.state_.PC >= 0x8000 && !CPU_.state_.halted) {
+    RecompiledBlock block = recompiled_->block(CPU_.state_.PC);
+    if (block) {
+      CPU_.state_.PC = block(CPU_);
+    } else {  // A computed jump the recompiler couldn't see
+      CPU_.ExecuteInstruction(read32(CPU_.state_.PC));
+    }
+  }
 }
 
 // Save Functions
 void Console::saveState(const std::string &filename) {
   std::ofstream out(filename, std::ios::binary);
   if (out.is_open()) {
+    out.write(kSaveMagic, sizeof(kSaveMagic));
+    out.write(reinterpret_cast<const char *>(&kSaveVersion),
+              sizeof(kSaveVersion));
     CPU_.saveState(out);
     GPU_.saveState(out);
     // Save RAM
     out.write(reinterpret_cast<char *>(&RAM_[0]),
               RAM_.size() * sizeof(RAM_[0]));
+    memory_->saveState(out);
     // Save Console state variables
     out.write(reinterpret_cast<char *>(&show_fps_), sizeof(show_fps_));
     out.write(reinterpret_cast<char *>(&paused_), sizeof(paused_));
@@ -173,10 +248,21 @@ void Console::saveState(const std::string &filename) {
 void Console::loadState(const std::string &filename) {
   std::ifstream in(filename, std::ios::binary);
   if (in.is_open()) {
+    char magic[sizeof(kSaveMagic)] = {};
+    uint32_t version = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&version), sizeof(version));
+    if (!in || std::memcmp(magic, kSaveMagic, sizeof(magic)) != 0 ||
+        version != kSaveVersion) {
+      std::cerr << filename << " is not a save state from this version"
+                << std::endl;
+      return;
+    }
     CPU_.loadState(in);
     GPU_.loadState(in);
     // Load RAM
     in.read(reinterpret_cast<char *>(&RAM_[0]), RAM_.size() * sizeof(RAM_[0]));
+    memory_->loadState(in);
     // Load Console state variables
     in.read(reinterpret_cast<char *>(&show_fps_), sizeof(show_fps_));
     in.read(reinterpret_cast<char *>(&paused_), sizeof(paused_));
@@ -197,6 +283,8 @@ std::string Console::getSaveStateFilename(int slot) const {
 
 void Console::controllerInput() {
   while (SDL_PollEvent(&event_) && event_.type != SDL_QUIT) {
+    uint8_t controller = RAM_[kControllerDataAddress];
+
     // controller buttons
     switch (event_.type) {
       case SDL_KEYDOWN:  // ON KEY DOWN
@@ -261,6 +349,15 @@ void Console::controllerInput() {
       default:
         break;
     }
+    if (RAM_[kControllerDataAddress] != controller) {
+      // SDL timestamps are in ms since SDL_Init; backdate to when the key
+      // event was queued, not when we got around to polling it
+      input_latency_.keyEvent(
+          InputLatency::Clock::now() -
+              std::chrono::milliseconds(SDL_GetTicks() -
+                                        event_.key.timestamp),
+          frame_index_);
+    }
     // filters/FPS keybinds
     switch (event_.type) {
       case SDL_KEYDOWN:  // ON KEY DOWN
@@ -295,6 +392,11 @@ void Console::controllerInput() {
               GPU_.toggleDuckSkin();
             }
             break;
+          case SDLK_7:  // pressing F + 7 cycles through the scalers
+            if (SDL_GetKeyboardState(NULL)[SDL_SCANCODE_F] == true) {
+              GPU_.cycleScaler();
+            }
+            break;
           case SDLK_x:  // custom image
             GPU_.toggleImage();
             break;
@@ -362,14 +464,22 @@ void Console::controllerInput() {
   }
 }
 
+void Console::noteControllerRead(uint16_t address, int bytes) const {
+  if (static_cast<uint16_t>(kControllerDataAddress - address) < bytes) {
+    input_latency_.controllerRead(frame_index_);
+  }
+}
+
 uint8_t Console::read8(uint16_t address) const {
   if (readable(address)) {
+    noteControllerRead(address, 1);
     return RAM_[address];
   }
   return 0;
 }
 
 uint16_t Console::read16(uint16_t address) const {
+  noteControllerRead(address, 2);
   uint16_t data = 0;
   for (int i = 0; i < 2; i++) {
     if (readable(address)) {
@@ -382,6 +492,7 @@ uint16_t Console::read16(uint16_t address) const {
 }
 
 uint32_t Console::read32(uint16_t address) const {
+  noteControllerRead(address, 4);
   uint32_t data = 0;
   for (int i = 0; i < 4; i++) {
     if (readable(address)) {
@@ -427,7 +538,9 @@ bool Console::writable(uint16_t address, int bytes) const {
     if ((address + i >= kRAMAddress && address + i <= kRAMAddress + kRAMSize) ||
         (address + i == kDebugstdoutAddress) ||
         (address + i == kDebugstderrAddress) ||
-        (address + i == kStopExecutionAddress)) {
+        (address + i == kStopExecutionAddress) ||
+        (address + i == kROMBankAddress) ||
+        (address + i == kVRAMBankAddress)) {
     } else {
       return false;
     }
@@ -449,7 +562,7 @@ void Console::Disassemble() {
               read32(kDataSizeAddress));
 
   // 3. Initialize stack pointer register to the end of the stack (0x5200)
-  CPU_.registers_[29] = kVRAMAddress;
+  CPU_.state_.registers[29] = kVRAMAddress;
 
   std::cout << std::string(22, '*') << std::endl;
   std::cout << " Launching Disassembler\n";
@@ -497,8 +610,7 @@ void Console::Decode(int startAddress, int numToDecode) {
   uint16_t nextInstruction = static_cast<uint16_t>(startAddress);
   for (int i = 0; i < numToDecode; i++) {
     uint32_t instruction = read32(static_cast<uint16_t>(nextInstruction));
-    CPU_.DecodeInstruction(instruction);
-    CPU_.PrintInstruction();
+    BananaCpu::PrintInstruction(BananaCpu::Decode(instruction));
     nextInstruction += 0x0004;
   }
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -12,28 +13,66 @@
 #include <vector>
 
 #include "cpu.h"
+#include "debugger.h"
 #include "gpu.h"
+#include "latency.h"
+#include "memory.h"
+#include "recompiled.h"
+
+// Where a headless console reads debug stdin and writes debug stdout/stderr
+struct HeadlessIO {
+  std::istream &in;
+  std::ostream &out;
+  std::ostream &err;
+};
 
 class Console {
  private:
   std::unique_ptr<char[]> contents_;  // Memory buffer for file contents
 
+  // Headless consoles have no window, input or frame pacing
+  bool headless_ = false;
+  std::istream *in_ = &std::cin;
+  std::ostream *out_ = &std::cout;
+  std::ostream *err_ = &std::cerr;
+  uint64_t frame_limit_ = UINT64_MAX;  // loop() calls before a headless stop
+
   std::string filename_;           // Name of the file
   size_t file_size_;               // Size of the file
   bool file_opened_successfully_;  // Flag to check if file opened successfully
   std::vector<uint8_t> RAM_;
+  std::unique_ptr<MemoryController> memory_;  // Profile-specific banking
   BananaCpu CPU_;
   BananaGpu GPU_;
+  BananaDebugger debugger_;
+  const RecompiledRom *recompiled_ = nullptr;  // Linked-in translation
 
-  SDL_Event event_;
+  SDL_Event event_ = {};
   bool show_fps_ = false;
   bool paused_ = false;
   int target_fps_ = 60;
   double frame_time_ = 1.0 / target_fps_;
 
+  // Input latency
+  bool low_latency_ = false;  // Sleep before polling input, not after render
+  uint64_t frame_index_ = 0;
+  mutable InputLatency input_latency_;  // Updated by the read functions
+
+  // Counts a read of bytes bytes at address for input latency if it covers
+  // the controller byte
+  void noteControllerRead(uint16_t address, int bytes) const;
+
   // Helper function to check file extension
   static bool hasExtension(const std::string &filename,
                            const std::string &extension);
+  void open(const std::vector<std::string> &allowed_extensions);
+
+  // Runs the CPU until PC wraps back to 0; the kDebug core consults the
+  // debugger before every instruction
+  void execute();
+  template <bool kDebug>
+  void run();
+  void runRecompiled();
 
   // Decompiler
   void PrintMenu();
@@ -41,13 +80,31 @@ class Console {
 
  public:
   // Constructors
-  Console(const std::string &filename,
+  Console(const std::string &filename, ProfileId profile = ProfileId::kClassic,
           const std::vector<std::string> &allowed_extensions = {".slug"});
+  Console(const std::string &filename, const HeadlessIO &io,
+          ProfileId profile = ProfileId::kClassic);
 
   // Accessor methods
   std::string filename() const { return filename_; }
   size_t file_size() const { return file_size_; }
   bool isFileOpen() const { return file_opened_successfully_; }
+  const char *profileName() const { return memory_->name(); }
+  int displayWidth() const { return memory_->displayWidth(); }
+  int displayHeight() const { return memory_->displayHeight(); }
+  const uint8_t *frameBuffer() { return memory_->frameBuffer(); }
+  BananaDebugger &debugger() { return debugger_; }
+  void setScaler(ScalerId scaler) { GPU_.setScaler(scaler); }
+  void setLowLatency(bool low_latency) { low_latency_ = low_latency; }
+  InputLatency &inputLatency() { return input_latency_; }
+  bool recompiled() const { return recompiled_ != nullptr; }
+  bool headless() const { return headless_; }
+  bool halted() const { return CPU_.state_.halted; }
+  void setFrameLimit(uint64_t frames) { frame_limit_ = frames; }
+  std::istream &in() { return *in_; }
+  std::ostream &out() { return *out_; }
+  std::ostream &err() { return *err_; }
+  void disableRecompiled() { recompiled_ = nullptr; }
 
   void reset();
   void setup();
@@ -70,7 +127,14 @@ class Console {
   void write16(uint16_t addr, uint16_t data);
   void write32(uint16_t addr, uint32_t data);
 
-  // Save
+  // Bank switching
+  void selectROMBank(uint8_t bank) { memory_->selectROMBank(bank); }
+  void selectVRAMBank(uint8_t bank) { memory_->selectVRAMBank(bank); }
+
+  // Save. Files start with kSaveMagic and kSaveVersion; bump the version
+  // whenever any block's layout changes so stale files are refused.
+  static constexpr char kSaveMagic[4] = {'B', 'S', 'A', 'V'};
+  static constexpr uint32_t kSaveVersion = 2;
   void saveState(const std::string &filename);
   void loadState(const std::string &filename);
   std::string getSaveStateFilename(int slot) const;
@@ -91,6 +155,8 @@ class Console {
     kDebugstdoutAddress = 0x7110,     // w
     kDebugstderrAddress = 0x7120,     // w
     kStopExecutionAddress = 0x7200,   // w
+    kROMBankAddress = 0x7300,         // w
+    kVRAMBankAddress = 0x7301,        // w
 
     // SLUG Address Space          // Permissions
     kSLUGFileAddress = 0x8000,     // rx
@@ -11,239 +11,291 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 #include "console.h"
 
-BananaCpu::BananaCpu(Console& console, std::vector<uint8_t>& RAM)
-    : console_(console),
-      RAM_(RAM),
-      registers_(32, 0),
-      PC_(0),
-      op_table_(64, &BananaCpu::NOP),
-      function_table_(64, &BananaCpu::NOP) {
-  op_table_[kFUNC] = &BananaCpu::ExecuteRType;
-  op_table_[kBEQ] = &BananaCpu::BEQ;
-  op_table_[kSB] = &BananaCpu::SB;
-  op_table_[kJAL] = &BananaCpu::JAL;
-  op_table_[kLBU] = &BananaCpu::LBU;
-  op_table_[kJ] = &BananaCpu::J;
-  op_table_[kADDI] = &BananaCpu::ADDI;
-  op_table_[kBNE] = &BananaCpu::BNE;
-  op_table_[kLW] = &BananaCpu::LW;
-  op_table_[kSW] = &BananaCpu::SW;
-
-  function_table_[kSUB] = &BananaCpu::SUB;
-  function_table_[kSRL] = &BananaCpu::SRL;
-  function_table_[kAND] = &BananaCpu::AND;
-  function_table_[kNOR] = &BananaCpu::NOR;
-  function_table_[kSRA] = &BananaCpu::SRA;
-  function_table_[kSLL] = &BananaCpu::SLL;
-  function_table_[kJR] = &BananaCpu::JR;
-  function_table_[kOR] = &BananaCpu::OR;
-  function_table_[kSLT] = &BananaCpu::SLT;
-  function_table_[kADD] = &BananaCpu::ADD;
-}
+namespace {
 
-void BananaCpu::NOP() {  // No operation, just increment the program counter
-  PC_ += 4;
+// Handlers are free functions of (state, decoded instruction), specialized per
+// opcode or function code, so ExecuteInstruction's switch inlines them and
+// the decoded fields stay in host registers.
+
+// Every register write goes through here. Writing r0 and then clearing it is
+// cheaper than a branch on the destination.
+inline void write(CpuState& state, int16_t reg, int16_t value) {
+  state.registers[reg] = value;
+  state.registers[0] = 0;
 }
 
-// I Type
-void BananaCpu::BEQ() {  // Opcode: 2, Branch on Equal
-  if (registers_[reg_a_] == registers_[reg_b_]) {
-    PC_ += 4 * immediate_;
-  }
-  PC_ += 4;
+inline void nop(CpuState& state) {  // No operation, just increment the PC
+  state.PC += 4;
 }
 
-void BananaCpu::SB() {  // Opcode: 11, Store Byte
-  int addr = registers_[reg_a_] + immediate_;
-  console_.write8(addr, registers_[reg_b_] & 0xFF);
-  PC_ += 4;
+// R Type: reg_c = op(reg_a, reg_b)
+template <BananaCpu::FunctionCode kFunction>
+inline int16_t alu(int16_t a, int16_t b, int16_t shift);
 
-  if (addr == console_.kDebugstdoutAddress) {  // print to stdout
-    std::cout << (char)registers_[reg_b_];
-  } else if (addr == console_.kDebugstderrAddress) {  // print to stderr
-    std::cerr << (char)registers_[reg_b_];
-  } else if (addr ==
-             console_.kStopExecutionAddress) {  // terminate Banana execution
-    exit(0);
-  }
+template <>
+inline int16_t alu<BananaCpu::kSUB>(int16_t a, int16_t b, int16_t) {
+  return a - b;  // Function: 0, Subtract
 }
-
-void BananaCpu::JAL() {      // Opcode: 24, Jump and Link
-  registers_[31] = PC_ + 4;  // Link register
-  PC_ = 4 * immediate_;  // Jump to immediate (make sure immediate is already
-                         // the correct absolute address)
+template <>
+inline int16_t alu<BananaCpu::kSRL>(int16_t, int16_t b, int16_t shift) {
+  return (unsigned)b >> shift;  // Function: 13, Shift Right Logical
 }
-
-void BananaCpu::LBU() {  // Opcode: 25, Load Byte Unsigned
-  int addr = (registers_[reg_a_] + immediate_);
-
-  // Handle input from STDIN
-  if (addr == console_.kDebugstdinAddress) {
-    registers_[reg_b_] = static_cast<uint8_t>(std::cin.get());
-  } else {
-    registers_[reg_b_] = console_.read8(addr);
-  }
-  PC_ += 4;
+template <>
+inline int16_t alu<BananaCpu::kAND>(int16_t a, int16_t b, int16_t) {
+  return a & b;  // Function: 19, And
+}
+template <>
+inline int16_t alu<BananaCpu::kNOR>(int16_t a, int16_t b, int16_t) {
+  return ~(a | b);  // Function: 21, Nor
+}
+template <>
+inline int16_t alu<BananaCpu::kSRA>(int16_t, int16_t b, int16_t shift) {
+  return (signed)b >> shift;  // Function: 25, Shift Right Arithmetic
+}
+template <>
+inline int16_t alu<BananaCpu::kSLL>(int16_t, int16_t b, int16_t shift) {
+  return b << shift;  // Function: 30, Shift Left Logical
+}
+template <>
+inline int16_t alu<BananaCpu::kOR>(int16_t a, int16_t b, int16_t) {
+  return a | b;  // Function: 50, Or
+}
+template <>
+inline int16_t alu<BananaCpu::kSLT>(int16_t a, int16_t b, int16_t) {
+  return (a < b) ? 1 : 0;  // Function: 57, Set Less Than
+}
+template <>
+inline int16_t alu<BananaCpu::kADD>(int16_t a, int16_t b, int16_t) {
+  return a + b;  // Function: 60, Add
 }
 
-void BananaCpu::J() {  // Opcode: 37, Jump
-  PC_ = 4 * immediate_;
+template <BananaCpu::FunctionCode kFunction>
+inline void rType(CpuState& state, DecodedInstruction d) {
+  write(state, d.reg_c,
+        alu<kFunction>(state.registers[d.reg_a], state.registers[d.reg_b],
+                       d.shift_value));
+  state.PC += 4;
 }
 
-void BananaCpu::ADDI() {  // Opcode: 46, Add Immediate
-  registers_[reg_b_] = registers_[reg_a_] + immediate_;
-  PC_ += 4;
+template <>
+inline void rType<BananaCpu::kJR>(CpuState& state, DecodedInstruction d) {
+  state.PC = state.registers[d.reg_a];  // Function: 40, Jump Register
 }
 
-void BananaCpu::BNE() {  // Opcode: 51, Branch On Not Equal
-  if (registers_[reg_a_] != registers_[reg_b_]) {
-    PC_ = PC_ + 4 + (4 * immediate_);
-  } else {
-    PC_ += 4;
+// I Type
+template <BananaCpu::OpCode kOpCode>
+inline void iType(BananaCpu& cpu, CpuState& state, DecodedInstruction d);
+
+template <>  // Opcode: 2, Branch on Equal
+inline void iType<BananaCpu::kBEQ>(BananaCpu&, CpuState& state,
+                                   DecodedInstruction d) {
+  if (state.registers[d.reg_a] == state.registers[d.reg_b]) {
+    state.PC += 4 * d.immediate;
   }
+  state.PC += 4;
 }
 
-void BananaCpu::LW() {  // Opcode: 53, Load Word (2 Bytes)
-  registers_[reg_b_] = console_.read16(registers_[reg_a_] + immediate_);
-  PC_ += 4;
+template <>  // Opcode: 11, Store Byte
+inline void iType<BananaCpu::kSB>(BananaCpu& cpu, CpuState& state,
+                                  DecodedInstruction d) {
+  cpu.storeByte(state.registers[d.reg_a] + d.immediate,
+                state.registers[d.reg_b]);
+  state.PC += 4;
 }
 
-void BananaCpu::SW() {  // Opcode: 58, Store Word (2 Bytes)
-  console_.write16(registers_[reg_a_] + immediate_, registers_[reg_b_]);
-  PC_ += 4;
+template <>  // Opcode: 24, Jump and Link
+inline void iType<BananaCpu::kJAL>(BananaCpu&, CpuState& state,
+                                   DecodedInstruction d) {
+  write(state, 31, state.PC + 4);  // Link register
+  state.PC = 4 * d.immediate;      // immediate is the absolute address / 4
 }
 
-// R type
-void BananaCpu::SUB() {  // Function: 0, Subtract
-  registers_[reg_c_] = registers_[reg_a_] - registers_[reg_b_];
-  PC_ += 4;
+template <>  // Opcode: 25, Load Byte Unsigned
+inline void iType<BananaCpu::kLBU>(BananaCpu& cpu, CpuState& state,
+                                   DecodedInstruction d) {
+  write(state, d.reg_b, cpu.loadByte(state.registers[d.reg_a] + d.immediate));
+  state.PC += 4;
 }
 
-void BananaCpu::SRL() {  // Function: 13, Shift Right Logical
-  registers_[reg_c_] = (unsigned)registers_[reg_b_] >> shift_value_;
-  PC_ += 4;
+template <>  // Opcode: 37, Jump
+inline void iType<BananaCpu::kJ>(BananaCpu&, CpuState& state,
+                                 DecodedInstruction d) {
+  state.PC = 4 * d.immediate;
 }
 
-void BananaCpu::AND() {  // Function: 19, And
-  registers_[reg_c_] = registers_[reg_a_] & registers_[reg_b_];
-  PC_ += 4;
+template <>  // Opcode: 46, Add Immediate
+inline void iType<BananaCpu::kADDI>(BananaCpu&, CpuState& state,
+                                    DecodedInstruction d) {
+  write(state, d.reg_b, state.registers[d.reg_a] + d.immediate);
+  state.PC += 4;
 }
 
-void BananaCpu::NOR() {  // Function: 21, Nor
-  registers_[reg_c_] = ~(registers_[reg_a_] | registers_[reg_b_]);
-  PC_ += 4;
+template <>  // Opcode: 51, Branch On Not Equal
+inline void iType<BananaCpu::kBNE>(BananaCpu&, CpuState& state,
+                                   DecodedInstruction d) {
+  if (state.registers[d.reg_a] != state.registers[d.reg_b]) {
+    state.PC += 4 * d.immediate;
+  }
+  state.PC += 4;
 }
 
-void BananaCpu::SRA() {  // Function: 25, Shift Right Arithmetic
-  registers_[reg_c_] = (signed)registers_[reg_b_] >> shift_value_;
-  PC_ += 4;
+template <>  // Opcode: 53, Load Word (2 Bytes)
+inline void iType<BananaCpu::kLW>(BananaCpu& cpu, CpuState& state,
+                                  DecodedInstruction d) {
+  write(state, d.reg_b, cpu.loadWord(state.registers[d.reg_a] + d.immediate));
+  state.PC += 4;
 }
 
-void BananaCpu::SLL() {  // Function: 30, Shift Left Logical
-  registers_[reg_c_] = (registers_[reg_b_] << shift_value_);
-  PC_ += 4;
+template <>  // Opcode: 58, Store Word (2 Bytes)
+inline void iType<BananaCpu::kSW>(BananaCpu& cpu, CpuState& state,
+                                  DecodedInstruction d) {
+  cpu.storeWord(state.registers[d.reg_a] + d.immediate,
+                state.registers[d.reg_b]);
+  state.PC += 4;
 }
 
-void BananaCpu::JR() {  // Function: 40, Jump Register
-  PC_ = registers_[reg_a_];
+inline void executeRType(CpuState& state, DecodedInstruction d) {
+  switch (d.function) {
+    case BananaCpu::kSUB:
+      return rType<BananaCpu::kSUB>(state, d);
+    case BananaCpu::kSRL:
+      return rType<BananaCpu::kSRL>(state, d);
+    case BananaCpu::kAND:
+      return rType<BananaCpu::kAND>(state, d);
+    case BananaCpu::kNOR:
+      return rType<BananaCpu::kNOR>(state, d);
+    case BananaCpu::kSRA:
+      return rType<BananaCpu::kSRA>(state, d);
+    case BananaCpu::kSLL:
+      return rType<BananaCpu::kSLL>(state, d);
+    case BananaCpu::kJR:
+      return rType<BananaCpu::kJR>(state, d);
+    case BananaCpu::kOR:
+      return rType<BananaCpu::kOR>(state, d);
+    case BananaCpu::kSLT:
+      return rType<BananaCpu::kSLT>(state, d);
+    case BananaCpu::kADD:
+      return rType<BananaCpu::kADD>(state, d);
+    default:
+      return nop(state);
+  }
 }
 
-void BananaCpu::OR() {  // Function: 50, Or
-  registers_[reg_c_] = registers_[reg_a_] | registers_[reg_b_];
-  PC_ += 4;
-}
+}  // namespace
 
-void BananaCpu::SLT() {  // Function: 57, Set Less Than
-  registers_[reg_c_] = (registers_[reg_a_] < registers_[reg_b_]) ? 1 : 0;
-  PC_ += 4;
-}
+BananaCpu::BananaCpu(Console& console, std::vector<uint8_t>& RAM)
+    : console_(console), RAM_(RAM) {}
+
+void BananaCpu::ExecuteInstruction(uint32_t instruction) {
+  DecodedInstruction d = Decode(instruction);
+  CpuState& state = state_;
 
-void BananaCpu::ADD() {  // Function: 60, Add
-  registers_[reg_c_] = registers_[reg_a_] + registers_[reg_b_];
-  PC_ += 4;
+  if (state.PC < console_.kSLUGFileAddress) {
+    return nop(state);
+  }
+  switch (d.op_code) {
+    case kFUNC:
+      return executeRType(state, d);
+    case kBEQ:
+      return iType<kBEQ>(*this, state, d);
+    case kSB:
+      return iType<kSB>(*this, state, d);
+    case kJAL:
+      return iType<kJAL>(*this, state, d);
+    case kLBU:
+      return iType<kLBU>(*this, state, d);
+    case kJ:
+      return iType<kJ>(*this, state, d);
+    case kADDI:
+      return iType<kADDI>(*this, state, d);
+    case kBNE:
+      return iType<kBNE>(*this, state, d);
+    case kLW:
+      return iType<kLW>(*this, state, d);
+    case kSW:
+      return iType<kSW>(*this, state, d);
+    default:
+      return nop(state);
+  }
 }
 
-void BananaCpu::ExecuteInstruction(uint32_t instruction) {
-  DecodeInstruction(instruction);
+void BananaCpu::call(int16_t immediate) {
+  DecodedInstruction jal = {};
+  jal.op_code = kJAL;
+  jal.immediate = immediate;
+  state_.PC = 0xfffc;
+  iType<kJAL>(*this, state_, jal);
+}
 
-  if (op_code_ < op_table_.size() && PC_ >= console_.kSLUGFileAddress) {
-    (this->*op_table_[op_code_])();
-  } else {
-    NOP();
+// Memory
+int16_t BananaCpu::loadByte(int addr) {
+  if (addr == console_.kDebugstdinAddress) {  // Handle input from STDIN
+    return static_cast<uint8_t>(console_.in().get());
   }
+  return console_.read8(addr);
 }
 
-void BananaCpu::ExecuteRType() {
-  if (function_ < function_table_.size()) {
-    (this->*function_table_[function_])();
-  } else {
-    NOP();
+void BananaCpu::storeByte(int addr, int16_t value) {
+  console_.write8(addr, value & 0xFF);
+
+  if (addr == console_.kDebugstdoutAddress) {  // print to stdout
+    console_.out() << (char)value;
+  } else if (addr == console_.kDebugstderrAddress) {  // print to stderr
+    console_.err() << (char)value;
+  } else if (addr ==
+             console_.kStopExecutionAddress) {  // terminate Banana execution
+    state_.halted = true;
+  } else if (addr == console_.kROMBankAddress) {  // switch ROM window bank
+    console_.selectROMBank(value & 0xFF);
+  } else if (addr == console_.kVRAMBankAddress) {  // switch VRAM window bank
+    console_.selectVRAMBank(value & 0xFF);
   }
 }
 
-void BananaCpu::DecodeInstruction(uint32_t instruction) {
-  // mask and decode 32 bit instruction
-  op_code_ = (instruction >> 26) & 0x0000003F;     // get bits 26-31
-  reg_a_ = (instruction & 0x03E00000) >> 21;       // bits 21-25
-  reg_b_ = (instruction & 0x001F0000) >> 16;       // bits 16-20
-  reg_c_ = (instruction & 0x0000F800) >> 11;       // bits 11-15
-  shift_value_ = (instruction & 0x000007C0) >> 6;  // bits 6-10
-  function_ = instruction & 0x0000003F;            // bits 0-5
-  immediate_ = instruction & 0x0000FFFF;           // bits 0-15
+int16_t BananaCpu::loadWord(int addr) { return console_.read16(addr); }
+
+void BananaCpu::storeWord(int addr, int16_t value) {
+  console_.write16(addr, value);
 }
 
-// Save and Load
+// Save and Load. The state is written as it sits in memory, so CpuState must
+// stay plain data; Console versions the file around it.
+static_assert(std::is_trivially_copyable<CpuState>::value,
+              "CpuState is saved byte for byte");
+
 void BananaCpu::saveState(std::ofstream& out) {
-  out.write(reinterpret_cast<char*>(&PC_), sizeof(PC_));
-  out.write(reinterpret_cast<char*>(&op_code_), sizeof(op_code_));
-  out.write(reinterpret_cast<char*>(&reg_a_), sizeof(reg_a_));
-  out.write(reinterpret_cast<char*>(&reg_b_), sizeof(reg_b_));
-  out.write(reinterpret_cast<char*>(&reg_c_), sizeof(reg_c_));
-  out.write(reinterpret_cast<char*>(&shift_value_), sizeof(shift_value_));
-  out.write(reinterpret_cast<char*>(&function_), sizeof(function_));
-  out.write(reinterpret_cast<char*>(&immediate_), sizeof(immediate_));
-  out.write(reinterpret_cast<char*>(registers_.data()),
-            registers_.size() * sizeof(registers_[0]));
-  // Save other necessary state variables...
+  out.write(reinterpret_cast<char*>(&state_), sizeof(state_));
 }
 
 void BananaCpu::loadState(std::ifstream& in) {
-  in.read(reinterpret_cast<char*>(&PC_), sizeof(PC_));
-  in.read(reinterpret_cast<char*>(&op_code_), sizeof(op_code_));
-  in.read(reinterpret_cast<char*>(&reg_a_), sizeof(reg_a_));
-  in.read(reinterpret_cast<char*>(&reg_b_), sizeof(reg_b_));
-  in.read(reinterpret_cast<char*>(&reg_c_), sizeof(reg_c_));
-  in.read(reinterpret_cast<char*>(&shift_value_), sizeof(shift_value_));
-  in.read(reinterpret_cast<char*>(&function_), sizeof(function_));
-  in.read(reinterpret_cast<char*>(&immediate_), sizeof(immediate_));
-  in.read(reinterpret_cast<char*>(registers_.data()),
-          registers_.size() * sizeof(registers_[0]));
-  // Load other necessary state variables...
+  in.read(reinterpret_cast<char*>(&state_), sizeof(state_));
+  state_.registers[0] = 0;
 }
 
-void BananaCpu::PrintInstruction() {
+void BananaCpu::PrintInstruction(const DecodedInstruction& d) {
   bool isRType = false;
-  switch (op_code_) {
+  switch (d.op_code) {
     case kFUNC:
       isRType = true;
       break;
     case kBEQ:
       std::cout << "Opcode: Branch On Equal\t\t\t\t"
-                << "if Register[" << reg_a_ << "] == Register[" << reg_b_
-                << "]\t PC = PC+4 + 4*" << std::dec << immediate_ << std::endl;
+                << "if Register[" << d.reg_a << "] == Register[" << d.reg_b
+                << "]\t PC = PC+4 + 4*" << std::dec << d.immediate << std::endl;
       break;
     case kSB:
       std::cout << "Opcode: Store Byte\t\t\t\t"
-                << "Ram[Reg[" << reg_a_ << "] + ";
-      if (immediate_ == 0) {
+                << "Ram[Reg[" << d.reg_a << "] + ";
+      if (d.immediate == 0) {
         std::cout << "0x0000]";
       } else {
-        std::cout << "0x" << std::hex << immediate_;
+        std::cout << "0x" << std::hex << d.immediate;
       }
-      std::cout << "] = Reg[" << reg_b_ << "]\n";
+      std::cout << "] = Reg[" << d.reg_b << "]\n";
       break;
     case kJAL:
       std::cout << "Opcode: Jump And Link\t\t\t\t"
@@ -253,30 +305,30 @@ void BananaCpu::PrintInstruction() {
       break;
     case kLBU:
       std::cout << "Opcode: Load Byte Unsigned\t\t\t"
-                << "Ram[" << reg_b_ << "] = Ram[Reg[" << reg_a_ << "] + "
-                << std::dec << immediate_ << "]\n";
+                << "Ram[" << d.reg_b << "] = Ram[Reg[" << d.reg_a << "] + "
+                << std::dec << d.immediate << "]\n";
       break;
     case kJ:
-      std::cout << "Opcode: Jump\t\t\t\tPC=4*" << immediate_ << std::endl;
+      std::cout << "Opcode: Jump\t\t\t\tPC=4*" << d.immediate << std::endl;
       break;
     case kADDI:
       std::cout << "Opcode: Add Immediate:\t\t\t\t"
-                << "Reg[" << reg_b_ << "] = Reg[" << reg_a_ << "] + "
-                << std::dec << immediate_ << std::endl;
+                << "Reg[" << d.reg_b << "] = Reg[" << d.reg_a << "] + "
+                << std::dec << d.immediate << std::endl;
       break;
     case kBNE:
       std::cout << "Opcode: Branch On Not Equal\t\t\t"
-                << "if Reg[" << reg_a_ << "] != Reg[" << reg_b_
-                << "]\t PC = PC+4 + 4*" << std::dec << immediate_ << std::endl;
+                << "if Reg[" << d.reg_a << "] != Reg[" << d.reg_b
+                << "]\t PC = PC+4 + 4*" << std::dec << d.immediate << std::endl;
       break;
     case kLW:
-      std::cout << "Opcode: Load Word\t\t\t\tReg[" << reg_b_ << "] = Ram[Reg["
-                << reg_a_ << "] + " << std::dec << immediate_ << "]\n";
+      std::cout << "Opcode: Load Word\t\t\t\tReg[" << d.reg_b << "] = Ram[Reg["
+                << d.reg_a << "] + " << std::dec << d.immediate << "]\n";
       ;
       break;
     case kSW:
-      std::cout << "Opcode: Store Word\t\t\t\tRam[Reg[" << reg_a_ << "] + "
-                << std::dec << immediate_ << "] = Reg[" << reg_b_ << "]\n";
+      std::cout << "Opcode: Store Word\t\t\t\tRam[Reg[" << d.reg_a << "] + "
+                << std::dec << d.immediate << "] = Reg[" << d.reg_b << "]\n";
       break;
     default:
       std::cout << "Unknown opcode\n";
@@ -284,50 +336,50 @@ void BananaCpu::PrintInstruction() {
   }
 
   if (isRType == true) {
-    switch (op_code_) {
+    switch (d.op_code) {
       case kSUB:
         std::cout << "Function: 0, Subtract\t\t\t\t"
-                  << "Reg[" << reg_c_ << "] = Reg[" << reg_a_ << "] - Reg["
-                  << reg_b_ << "]\n";
+                  << "Reg[" << d.reg_c << "] = Reg[" << d.reg_a << "] - Reg["
+                  << d.reg_b << "]\n";
         break;
       case kSRL:
         std::cout << "Function: 13, Shift Right Logical\t\t"
-                  << "Reg[" << reg_c_ << "] = (unsigned)Reg[" << reg_b_
-                  << "] value >> shifted right " << shift_value_ << std::endl;
+                  << "Reg[" << d.reg_c << "] = (unsigned)Reg[" << d.reg_b
+                  << "] value >> shifted right " << d.shift_value << std::endl;
         break;
       case kAND:
-        std::cout << "Function: 19, And\t\t\t\tReg[" << reg_c_ << "] = Reg["
-                  << reg_a_ << "] & Reg[" << reg_b_ << "]\n";
+        std::cout << "Function: 19, And\t\t\t\tReg[" << d.reg_c << "] = Reg["
+                  << d.reg_a << "] & Reg[" << d.reg_b << "]\n";
         break;
       case kNOR:
-        std::cout << "Function: 21, Nor\t\t\t\tReg[" << reg_c_ << "] = ~(Reg["
-                  << reg_a_ << "] | Reg[" << reg_b_ << "])\n";
+        std::cout << "Function: 21, Nor\t\t\t\tReg[" << d.reg_c << "] = ~(Reg["
+                  << d.reg_a << "] | Reg[" << d.reg_b << "])\n";
         break;
       case kSRA:
-        std::cout << "Function: 25, Shift Right Arithmetic\t\tReg[" << reg_c_
-                  << "] = Reg[" << reg_b_ << "] shifted right" << shift_value_
+        std::cout << "Function: 25, Shift Right Arithmetic\t\tReg[" << d.reg_c
+                  << "] = Reg[" << d.reg_b << "] shifted right" << d.shift_value
                   << std::endl;
         break;
       case kSLL:
-        std::cout << "Function: 30, Shift Left Logical\t\tReg[" << reg_c_
-                  << "] = Reg[" << reg_b_ << "] shifted left" << shift_value_
+        std::cout << "Function: 30, Shift Left Logical\t\tReg[" << d.reg_c
+                  << "] = Reg[" << d.reg_b << "] shifted left" << d.shift_value
                   << std::endl;
         break;
       case kJR:
-        std::cout << "Function: 40, Jump Register\t\tPC = Reg[" << reg_a_
+        std::cout << "Function: 40, Jump Register\t\tPC = Reg[" << d.reg_a
                   << "]\n";
         break;
       case kOR:
-        std::cout << "Function: 50, Or\t\t\t\tReg[" << reg_c_ << "] = Reg["
-                  << reg_a_ << "] | Reg[" << reg_b_ << "]\n";
+        std::cout << "Function: 50, Or\t\t\t\tReg[" << d.reg_c << "] = Reg["
+                  << d.reg_a << "] | Reg[" << d.reg_b << "]\n";
         break;
       case kSLT:
-        std::cout << "Function: 57, Set Less Than\t\tReg[" << reg_c_
-                  << "] = Reg[" << reg_a_ << "] + Reg[" << reg_b_ << "]\n";
+        std::cout << "Function: 57, Set Less Than\t\tReg[" << d.reg_c
+                  << "] = Reg[" << d.reg_a << "] + Reg[" << d.reg_b << "]\n";
         break;
       case kADD:
-        std::cout << "Function: 60, Add\t\t\t\tReg[" << reg_c_ << "] = Reg["
-                  << reg_a_ << "] + Reg[" << reg_b_ << "]\n";
+        std::cout << "Function: 60, Add\t\t\t\tReg[" << d.reg_c << "] = Reg["
+                  << d.reg_a << "] + Reg[" << d.reg_b << "]\n";
         break;
       default:
         std::cout << "Unknown function code" << std::endl;
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -11,20 +13,26 @@
 
 class Console;
 
+// The fields of one 32-bit SLUG instruction; which ones matter depends on the
+// opcode. Decoded once per step and passed by value, never stored.
+struct DecodedInstruction {
+  int16_t op_code, reg_a, reg_b, reg_c, shift_value, function, immediate;
+};
+
+// Everything an instruction can change besides memory. r0 always reads 0.
+struct CpuState {
+  std::array<int16_t, 32> registers = {};
+  uint16_t PC = 0;      // Program Counter
+  bool halted = false;  // Set by a store to the stop-execution address
+};
+
 class BananaCpu {
- protected:
  private:
   Console& console_;
   std::vector<uint8_t>& RAM_;
 
  public:
-  typedef void (BananaCpu::*Instruction)();
-  std::vector<Instruction> op_table_;
-  std::vector<Instruction> function_table_;
-  std::vector<int16_t> registers_;
-
-  int16_t op_code_, reg_a_, reg_b_, reg_c_, shift_value_, function_, immediate_;
-  uint16_t PC_;  // Program Counter
+  CpuState state_;
 
   // Constructor
   BananaCpu(Console& OS, std::vector<uint8_t>& RAM);
@@ -35,9 +43,31 @@ class BananaCpu {
 
   // Decode / Execute
   void ExecuteInstruction(uint32_t);  // Decodes & Execute Instruction
-  void ExecuteRType();                // Called if R-Type Instruction
-  void DecodeInstruction(uint32_t);
-  void PrintInstruction();
+  static void PrintInstruction(const DecodedInstruction& decoded);
+
+  // Pure decode, shared with the debugger and the static recompiler
+  static DecodedInstruction Decode(uint32_t instruction) {
+    DecodedInstruction decoded;
+    decoded.op_code = (instruction >> 26) & 0x0000003F;     // bits 26-31
+    decoded.reg_a = (instruction & 0x03E00000) >> 21;       // bits 21-25
+    decoded.reg_b = (instruction & 0x001F0000) >> 16;       // bits 16-20
+    decoded.reg_c = (instruction & 0x0000F800) >> 11;       // bits 11-15
+    decoded.shift_value = (instruction & 0x000007C0) >> 6;  // bits 6-10
+    decoded.function = instruction & 0x0000003F;            // bits 0-5
+    decoded.immediate = instruction & 0x0000FFFF;           // bits 0-15
+    return decoded;
+  }
+
+  // Calls the routine at 4 * immediate as a JAL from 0xfffc would, so its
+  // final JR wraps PC back to 0
+  void call(int16_t immediate);
+
+  // Memory accesses with the IO side effects of LBU/SB/LW/SW. addr is the
+  // untruncated base + offset sum, as the IO checks compare it unwrapped.
+  int16_t loadByte(int addr);
+  void storeByte(int addr, int16_t value);
+  int16_t loadWord(int addr);
+  void storeWord(int addr, int16_t value);
 
   enum OpCode {
     // I types
@@ -66,30 +96,4 @@ class BananaCpu {
     kSLT = 0x39,  // Function: 57, Set Less Than
     kADD = 0x3C   // Function: 60, Add
   };
-
-  // CPU Instructions
-  void NOP();
-
-  // I Type Instructions
-  void BEQ();
-  void SB();
-  void JAL();
-  void LBU();
-  void J();
-  void ADDI();
-  void BNE();
-  void LW();
-  void SW();
-
-  // R Type Instructions
-  void SUB();
-  void SRL();
-  void AND();
-  void NOR();
-  void SRA();
-  void SLL();
-  void JR();
-  void OR();
-  void SLT();
-  void ADD();
-};
\ No newline at end of file
+};
@@ -0,0 +1,214 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "debugger.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "console.h"
+#include "cpu.h"
+
+void BananaDebugger::addWatchpoint(uint16_t first, uint16_t last, bool on_read,
+                                   bool on_write) {
+  if (first > last) {
+    std::swap(first, last);
+  }
+  watchpoints_.push_back({first, last, on_read, on_write});
+}
+
+bool BananaDebugger::parseAddress(const std::string &text, uint16_t &addr) {
+  try {
+    size_t used = 0;
+    unsigned long value = std::stoul(text, &used, 0);
+    if (used != text.size() || value > 0xFFFF) {
+      return false;
+    }
+    addr = static_cast<uint16_t>(value);
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+bool BananaDebugger::parseBreakpoint(const std::string &spec) {
+  uint16_t pc;
+  if (!parseAddress(spec, pc)) {
+    return false;
+  }
+  addBreakpoint(pc);
+  return true;
+}
+
+bool BananaDebugger::parseWatchpoint(const std::string &spec) {
+  std::string range = spec;
+  std::string mode = "rw";
+  size_t colon = spec.find(':');
+  if (colon != std::string::npos) {
+    range = spec.substr(0, colon);
+    mode = spec.substr(colon + 1);
+  }
+  if (mode != "r" && mode != "w" && mode != "rw") {
+    return false;
+  }
+
+  uint16_t first, last;
+  size_t dash = range.find('-');
+  if (dash == std::string::npos) {
+    if (!parseAddress(range, first)) {
+      return false;
+    }
+    last = first;
+  } else if (!parseAddress(range.substr(0, dash), first) ||
+             !parseAddress(range.substr(dash + 1), last)) {
+    return false;
+  }
+  addWatchpoint(first, last, mode != "w", mode != "r");
+  return true;
+}
+
+const BananaDebugger::Watchpoint *BananaDebugger::findWatchpoint(
+    uint16_t addr, int bytes, bool write) const {
+  for (const Watchpoint &watch : watchpoints_) {
+    if ((write ? watch.on_write : watch.on_read) && addr <= watch.last &&
+        addr + bytes - 1 >= watch.first) {
+      return &watch;
+    }
+  }
+  return nullptr;
+}
+
+void BananaDebugger::check(Console &console, BananaCpu &cpu,
+                           uint32_t instruction) {
+  std::ostringstream reason;
+  if (stepping_) {
+    reason << "step";
+  } else if (breakpoints_.count(cpu.state_.PC)) {
+    reason << "breakpoint";
+  }
+
+  // Work out the effective address of loads and stores before they execute
+  if (reason.tellp() == 0 && !watchpoints_.empty()) {
+    DecodedInstruction decoded = BananaCpu::Decode(instruction);
+    int bytes = 0;
+    bool write = false;
+    switch (decoded.op_code) {
+      case BananaCpu::kLBU:
+        bytes = 1;
+        break;
+      case BananaCpu::kSB:
+        bytes = 1;
+        write = true;
+        break;
+      case BananaCpu::kLW:
+        bytes = 2;
+        break;
+      case BananaCpu::kSW:
+        bytes = 2;
+        write = true;
+        break;
+      default:
+        break;
+    }
+    uint16_t addr = cpu.state_.registers[decoded.reg_a] + decoded.immediate;
+    if (bytes > 0 && findWatchpoint(addr, bytes, write) != nullptr) {
+      reason << "watchpoint: " << (write ? "write" : "read") << " of "
+             << bytes << " byte(s) at 0x" << std::hex << std::setw(4)
+             << std::setfill('0') << addr;
+    }
+  }
+
+  if (reason.tellp() != 0) {
+    std::cerr << "[debug] " << reason.str() << " (PC = 0x" << std::hex
+              << std::setw(4) << std::setfill('0') << cpu.state_.PC << std::dec
+              << ")" << std::endl;
+    BananaCpu::PrintInstruction(BananaCpu::Decode(instruction));
+    prompt(console, cpu);
+  }
+}
+
+void BananaDebugger::printRegisters(const BananaCpu &cpu) const {
+  std::cerr << std::hex << std::setfill('0');
+  std::cerr << "PC  = 0x" << std::setw(4) << cpu.state_.PC << std::endl;
+  for (int i = 0; i < 32; i++) {
+    std::cerr << "r" << std::dec << std::setw(2) << i << " = 0x" << std::hex
+              << std::setw(4) << static_cast<uint16_t>(cpu.state_.registers[i])
+              << ((i % 4 == 3) ? "\n" : "    ");
+  }
+  std::cerr << std::dec << std::setfill(' ');
+}
+
+void BananaDebugger::printMemory(const Console &console, uint16_t addr,
+                                 int count) const {
+  std::cerr << std::hex << std::setfill('0');
+  for (int i = 0; i < count; i++) {
+    uint16_t at = addr + i;
+    if (i % 16 == 0) {
+      std::cerr << (i ? "\n" : "") << std::setw(4) << at << ":";
+    }
+    std::cerr << " " << std::setw(2) << static_cast<int>(console.read8(at));
+  }
+  std::cerr << std::dec << std::setfill(' ') << std::endl;
+}
+
+void BananaDebugger::prompt(Console &console, BananaCpu &cpu) {
+  stepping_ = false;
+  if (!commands_.is_open()) {
+    commands_.open(command_path_);
+  }
+  std::string line;
+  while (true) {
+    std::cerr << "(banana) " << std::flush;
+    if (!std::getline(commands_, line)) {
+      // No one to talk to: disarm and run the rest of the ROM at full speed
+      breakpoints_.clear();
+      watchpoints_.clear();
+      return;
+    }
+
+    std::istringstream args(line);
+    std::string command, arg;
+    args >> command;
+    if (command.empty() || command == "c") {  // continue
+      return;
+    } else if (command == "s") {  // single-step
+      stepping_ = true;
+      return;
+    } else if (command == "r") {  // registers
+      printRegisters(cpu);
+    } else if (command == "b" || command == "d") {  // (un)set breakpoint
+      uint16_t pc;
+      if (!(args >> arg) || !parseAddress(arg, pc)) {
+        std::cerr << "usage: " << command << " <address>" << std::endl;
+      } else if (command == "b") {
+        addBreakpoint(pc);
+      } else if (!removeBreakpoint(pc)) {
+        std::cerr << "no breakpoint at " << arg << std::endl;
+      }
+    } else if (command == "w") {  // watchpoint
+      if (!(args >> arg)) {
+        clearWatchpoints();
+      } else if (!parseWatchpoint(arg)) {
+        std::cerr << "usage: w <first>[-<last>][:r|w|rw]" << std::endl;
+      }
+    } else if (command == "x") {  // examine memory
+      uint16_t addr;
+      int count = 16;
+      if (!(args >> arg) || !parseAddress(arg, addr)) {
+        std::cerr << "usage: x <address> [count]" << std::endl;
+      } else {
+        args >> count;
+        printMemory(console, addr, count);
+      }
+    } else if (command == "q") {
+      exit(0);
+    } else {
+      std::cerr << "c: continue    s: step        r: registers\n"
+                << "b/d <addr>: set/delete breakpoint\n"
+                << "w <first>[-<last>][:r|w|rw]: watch (no args clears)\n"
+                << "x <addr> [count]: examine memory    q: quit"
+                << std::endl;
+    }
+  }
+}
@@ -0,0 +1,63 @@
+// debugger.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+class Console;
+class BananaCpu;
+
+// Host-side debugger. Console only runs the instrumented core (which calls
+// check() before every instruction) while the debugger is armed, so the
+// normal core pays nothing for it.
+class BananaDebugger {
+ public:
+  struct Watchpoint {
+    uint16_t first, last;  // Inclusive address range
+    bool on_read, on_write;
+  };
+
+  bool armed() const {
+    return stepping_ || !breakpoints_.empty() || !watchpoints_.empty();
+  }
+
+  void addBreakpoint(uint16_t pc) { breakpoints_.insert(pc); }
+  bool removeBreakpoint(uint16_t pc) { return breakpoints_.erase(pc) > 0; }
+  void addWatchpoint(uint16_t first, uint16_t last, bool on_read,
+                     bool on_write);
+  void clearWatchpoints() { watchpoints_.clear(); }
+  void setStepping(bool stepping) { stepping_ = stepping; }
+
+  // Where the prompt reads commands; /dev/tty unless set. Never std::cin,
+  // which belongs to the ROM's debug stdin.
+  void setCommandInput(const std::string &path) { command_path_ = path; }
+
+  // Parses a command line option value: "0x8010" for a breakpoint,
+  // "0x5200-0x52ff:rw" (range and mode optional) for a watchpoint.
+  bool parseBreakpoint(const std::string &spec);
+  bool parseWatchpoint(const std::string &spec);
+
+  // Instrumented core hook: stops in the prompt when the instruction about to
+  // execute at cpu.state_.PC hits a breakpoint, a watchpoint, or single-step.
+  void check(Console &console, BananaCpu &cpu, uint32_t instruction);
+
+ private:
+  std::set<uint16_t> breakpoints_;
+  std::vector<Watchpoint> watchpoints_;
+  bool stepping_ = false;
+  std::string command_path_ = "/dev/tty";
+  std::ifstream commands_;  // Opened at the first stop
+
+  const Watchpoint *findWatchpoint(uint16_t addr, int bytes,
+                                   bool write) const;
+  void prompt(Console &console, BananaCpu &cpu);
+  void printRegisters(const BananaCpu &cpu) const;
+  void printMemory(const Console &console, uint16_t addr, int count) const;
+  static bool parseAddress(const std::string &text, uint16_t &addr);
+};
@@ -0,0 +1,251 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "filters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "duck.h"
+
+namespace {
+
+// Constants for the CRT Filter Effect (darken by 0.9, noise in [-5, 5])
+constexpr int kDarkenNumerator = 9;
+constexpr int kDarkenDenominator = 10;
+constexpr uint32_t kNoiseRange = 11;
+constexpr int kNoiseOffset = 5;
+
+struct RGB {
+  double r, g, b;
+};
+
+struct HSV {
+  double h, s, v;
+};
+
+HSV rgb2hsv(RGB in) {
+  HSV out;
+  double min, max, delta;
+
+  // Normalize values between 0 and 1
+  in.r /= 255.0;
+  in.g /= 255.0;
+  in.b /= 255.0;
+
+  // Find min and max values
+  min = std::min({in.r, in.g, in.b});
+  max = std::max({in.r, in.g, in.b});
+
+  out.v = max;
+  delta = max - min;
+
+  // Handle gray colors (undefined hue)
+  if (delta < 1e-6) {
+    out.s = 0;
+    out.h = 0;
+    return out;
+  }
+
+  out.s = delta / max;
+
+  // Calculate hue
+  double temp;
+  if (in.r == max) {
+    temp = (in.g - in.b) / delta;
+  } else if (in.g == max) {
+    temp = 2 + (in.b - in.r) / delta;
+  } else {
+    temp = 4 + (in.r - in.g) / delta;
+  }
+
+  out.h = std::fmod(temp * 60, 360);  // Wrap hue to 0-360 degrees
+
+  return out;
+}
+
+RGB hsv2rgb(HSV in) {
+  RGB out;
+  double c = in.v * in.s;
+  double x = c * (1 - std::abs(std::fmod(in.h / 60.0, 2) - 1));
+  double m = in.v - c;
+
+  // Map colors based on hue sector
+  if (in.h >= 0 && in.h < 60) {
+    out.r = c + m;
+    out.g = x + m;
+    out.b = m;
+  } else if (in.h >= 60 && in.h < 120) {
+    out.r = x + m;
+    out.g = c + m;
+    out.b = m;
+  } else if (in.h >= 120 && in.h < 180) {
+    out.r = m;
+    out.g = c + m;
+    out.b = x + m;
+  } else if (in.h >= 180 && in.h < 240) {
+    out.r = m;
+    out.g = x + m;
+    out.b = c + m;
+  } else if (in.h >= 240 && in.h < 300) {
+    out.r = x + m;
+    out.g = m;
+    out.b = c + m;
+  } else {
+    out.r = c + m;
+    out.g = m;
+    out.b = x + m;
+  }
+
+  // Denormalize values back to 0-255 range
+  out.r = out.r * 255;
+  out.g = out.g * 255;
+  out.b = out.b * 255;
+
+  return out;
+}
+
+HSV rotate_hue(HSV in, double degrees) {
+  in.h = std::fmod(in.h + degrees, 360.0);  // Wrap hue to 0-360 degrees
+  return in;
+}
+
+RGB unpack(uint32_t pixel) {
+  return {static_cast<double>((pixel >> 16) & 0xFF),
+          static_cast<double>((pixel >> 8) & 0xFF),
+          static_cast<double>(pixel & 0xFF)};
+}
+
+uint32_t pack(RGB rgb) {
+  uint8_t r = rgb.r, g = rgb.g, b = rgb.b;
+  return (r << 16) | (g << 8) | b;
+}
+
+uint32_t pastel(uint32_t pixel, int) {
+  HSV hsv = rgb2hsv(unpack(pixel));
+  hsv.s *= 0.6;
+  return pack(hsv2rgb(hsv));
+}
+
+uint32_t rotateHue(uint32_t pixel, int degrees) {
+  return pack(hsv2rgb(rotate_hue(rgb2hsv(unpack(pixel)), degrees)));
+}
+
+template <uint32_t (*Function)(uint32_t, int)>
+void cachedKernel(Frame &frame, ColorCache &cache, int argument) {
+  uint32_t *pixels = frame.pixels;
+  int count = frame.width * frame.height;
+  for (int i = 0; i < count; i++) {
+    uint32_t key = pixels[i];
+    uint32_t slot = (key * 2654435761u) >> 20;  // 12-bit hash
+    if (cache.keys[slot] != key) {
+      cache.keys[slot] = key;
+      cache.values[slot] = Function(key, argument);
+    }
+    pixels[i] = cache.values[slot];
+  }
+}
+
+uint32_t darken(uint32_t channel) {
+  return channel * kDarkenNumerator / kDarkenDenominator;
+}
+
+uint32_t addNoise(uint32_t channel, int noise) {
+  return std::clamp(static_cast<int>(channel) + noise, 0, 255);
+}
+
+uint32_t xorshift32(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+}  // namespace
+
+FilterContext::FilterContext(int width, int height)
+    : duck_mask(width * height, 0xFFFFFFFF), duck_color(width * height, 0) {
+  for (int y = 0; y < std::min(height, kDuckHeight); y++) {
+    for (int x = 0; x < std::min(width, kDuckWidth); x++) {
+      int32_t color = duckColor(kDuckSkin[y][x]);
+      if (color >= 0) {
+        duck_mask[y * width + x] = 0;
+        duck_color[y * width + x] = color;
+      }
+    }
+  }
+}
+
+void FilterContext::beginFrame(uint32_t frame_number) {
+  // Any nonzero seed works for xorshift; mix the frame number so that
+  // consecutive frames do not get correlated noise
+  noise_state = (frame_number + 1) * 0x9E3779B9u;
+  if (noise_state == 0) {
+    noise_state = 1;
+  }
+}
+
+void duckSkinKernel(Frame &frame, FilterContext &context) {
+  uint32_t *pixels = frame.pixels;
+  const uint32_t *mask = context.duck_mask.data();
+  const uint32_t *color = context.duck_color.data();
+  int count = frame.width * frame.height;
+  for (int i = 0; i < count; i++) {
+    pixels[i] = (pixels[i] & mask[i]) | color[i];
+  }
+}
+
+void grayScaleKernel(Frame &frame, FilterContext &) {
+  uint32_t *pixels = frame.pixels;
+  int count = frame.width * frame.height;
+  for (int i = 0; i < count; i++) {
+    uint32_t r = (pixels[i] >> 16) & 0xFF;
+    uint32_t g = (pixels[i] >> 8) & 0xFF;
+    uint32_t b = pixels[i] & 0xFF;
+    uint32_t luminance = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    pixels[i] = (luminance << 16) | (luminance << 8) | luminance;
+  }
+}
+
+void invertKernel(Frame &frame, FilterContext &) {
+  uint32_t *pixels = frame.pixels;
+  int count = frame.width * frame.height;
+  for (int i = 0; i < count; i++) {
+    pixels[i] ^= 0x00FFFFFF;
+  }
+}
+
+void pastelKernel(Frame &frame, FilterContext &context) {
+  cachedKernel<pastel>(frame, context.pastel_cache, 0);
+}
+
+void hueKernel(Frame &frame, FilterContext &context) {
+  if (context.hue_cache_rotation != context.hue_rotation) {
+    context.hue_cache.clear();
+    context.hue_cache_rotation = context.hue_rotation;
+  }
+  cachedKernel<rotateHue>(frame, context.hue_cache, context.hue_rotation);
+}
+
+void crtKernel(Frame &frame, FilterContext &context) {
+  // Darken the pixels in every other line
+  for (int y = 0; y < frame.height; y += 2) {
+    uint32_t *row = frame.pixels + y * frame.width;
+    for (int x = 0; x < frame.width; x++) {
+      row[x] = (darken((row[x] >> 16) & 0xFF) << 16) |
+               (darken((row[x] >> 8) & 0xFF) << 8) | darken(row[x] & 0xFF);
+    }
+  }
+
+  // Add random noise, the same amount to each channel of a pixel
+  uint32_t *pixels = frame.pixels;
+  int count = frame.width * frame.height;
+  for (int i = 0; i < count; i++) {
+    int noise =
+        static_cast<int>(xorshift32(context.noise_state) % kNoiseRange) -
+        kNoiseOffset;
+    pixels[i] = (addNoise((pixels[i] >> 16) & 0xFF, noise) << 16) |
+                (addNoise((pixels[i] >> 8) & 0xFF, noise) << 8) |
+                addNoise(pixels[i] & 0xFF, noise);
+  }
+}
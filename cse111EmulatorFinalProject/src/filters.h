@@ -0,0 +1,73 @@
+// filters.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Whole-frame post-processing for BananaGpu. A frame is a row-major array of
+// 0x00RRGGBB pixels; each stage is a kernel that runs over the whole frame,
+// so the per-pixel loops stay free of flag checks and vectorize.
+
+struct Frame {
+  uint32_t *pixels;
+  int width;
+  int height;
+};
+
+// Memoizes an expensive per-color function. Banana frames only use a handful
+// of colors, so most pixels are a single table hit.
+struct ColorCache {
+  static constexpr int kSize = 4096;
+  std::array<uint32_t, kSize> keys;
+  std::array<uint32_t, kSize> values;
+
+  ColorCache() { clear(); }
+  void clear() { keys.fill(0xFFFFFFFF); }
+};
+
+// State shared by the kernels. It lives as long as the GPU.
+struct FilterContext {
+  int hue_rotation = 0;      // Degrees, for the hue kernel
+  uint32_t noise_state = 1;  // xorshift32 state, reseeded every frame
+
+  // Duck skin, precomputed for the frame size: pixel = (pixel & mask) | color
+  std::vector<uint32_t> duck_mask;
+  std::vector<uint32_t> duck_color;
+
+  ColorCache pastel_cache;  // Pastel never changes, so this persists
+  ColorCache hue_cache;     // Cleared whenever hue_rotation changes
+  int hue_cache_rotation = -1;
+
+  FilterContext(int width, int height);
+  void beginFrame(uint32_t frame_number);
+};
+
+typedef void (*FilterKernel)(Frame &frame, FilterContext &context);
+
+// Kernels, in the order BananaGpu applies them
+void duckSkinKernel(Frame &frame, FilterContext &context);
+void grayScaleKernel(Frame &frame, FilterContext &context);
+void invertKernel(Frame &frame, FilterContext &context);
+void pastelKernel(Frame &frame, FilterContext &context);
+void hueKernel(Frame &frame, FilterContext &context);
+void crtKernel(Frame &frame, FilterContext &context);
+
+class FilterPipeline {
+ private:
+  std::vector<FilterKernel> stages_;
+
+ public:
+  void clear() { stages_.clear(); }
+  void add(FilterKernel kernel) { stages_.push_back(kernel); }
+  bool empty() const { return stages_.empty(); }
+
+  void run(Frame &frame, FilterContext &context) const {
+    for (FilterKernel kernel : stages_) {
+      kernel(frame, context);
+    }
+  }
+};
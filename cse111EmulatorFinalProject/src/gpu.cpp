@@ -3,7 +3,17 @@
 #include "console.h"
 
 BananaGpu::BananaGpu(Console& console, std::vector<uint8_t>& RAM)
-    : console_(console), RAM_(RAM) {
+    : console_(console),
+      RAM_(RAM),
+      headless_(console.headless()),
+      frame_(console.displayWidth() * console.displayHeight(), 0),
+      filter_context_(console.displayWidth(), console.displayHeight()),
+      width_(console.displayWidth()),
+      height_(console.displayHeight()) {
+  if (headless_) {
+    return;
+  }
+
   // Initialize SDL
   if (SDL_Init(SDL_INIT_VIDEO) < 0) {
     std::cerr << "Failed to initialize SDL: " << SDL_GetError() << std::endl;
@@ -13,8 +23,8 @@ BananaGpu::BananaGpu(Console& console, std::vector<uint8_t>& RAM)
   // Create a window
   window_ =
       SDL_CreateWindow("Banana", SDL_WINDOWPOS_UNDEFINED,
-                       SDL_WINDOWPOS_UNDEFINED, kDisplayWidth * kScaleFactor,
-                       kDisplayHeight * kScaleFactor, SDL_WINDOW_SHOWN);
+                       SDL_WINDOWPOS_UNDEFINED, kWindowWidth, kWindowHeight,
+                       SDL_WINDOW_SHOWN);
   if (!window_) {
     std::cerr << "Failed to create window: " << SDL_GetError() << std::endl;
     SDL_Quit();
@@ -24,11 +34,10 @@ BananaGpu::BananaGpu(Console& console, std::vector<uint8_t>& RAM)
   renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
 
   // Scale the window to be bigger
-  SDL_RenderSetLogicalSize(renderer_, kDisplayWidth, kDisplayHeight);
+  SDL_RenderSetLogicalSize(renderer_, width_, height_);
 
-  texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGB565,
-                               SDL_TEXTUREACCESS_STREAMING, kDisplayWidth,
-                               kDisplayHeight);
+  texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGB888,
+                               SDL_TEXTUREACCESS_STREAMING, width_, height_);
 
   // Image setup
   SDL_Init(SDL_INIT_TIMER | SDL_INIT_VIDEO);
@@ -37,167 +46,22 @@ BananaGpu::BananaGpu(Console& console, std::vector<uint8_t>& RAM)
 }
 
 BananaGpu::~BananaGpu() {
+  if (headless_) {
+    return;
+  }
   SDL_DestroyRenderer(renderer_);
   SDL_DestroyWindow(window_);
   SDL_DestroyTexture(texture_);
+  SDL_DestroyTexture(scaled_texture_);
   SDL_DestroyTexture(image_);
   SDL_Quit();
 }
 
-int BananaGpu::getPixelAddress(int width, int height) const {
-  int pixelIndex = width + (height * kDisplayWidth);
-  int pixelOffset = 2 * pixelIndex;
-  return 0x5200 + pixelOffset;
-}
-struct RGB {
-  double r, g, b;
-};
-
-struct HSV {
-  double h, s, v;
-};
-
-HSV rgb2hsv(RGB in) {
-  HSV out;
-  double min, max, delta;
-
-  // Normalize values between 0 and 1
-  in.r /= 255.0;
-  in.g /= 255.0;
-  in.b /= 255.0;
-
-  // Find min and max values
-  min = std::min({in.r, in.g, in.b});
-  max = std::max({in.r, in.g, in.b});
-
-  out.v = max;
-  delta = max - min;
-
-  // Handle gray colors (undefined hue)
-  if (delta < 1e-6) {
-    out.s = 0;
-    out.h = 0;
-    return out;
-  }
-
-  out.s = delta / max;
-
-  // Calculate hue
-  double temp;
-  if (in.r == max) {
-    temp = (in.g - in.b) / delta;
-  } else if (in.g == max) {
-    temp = 2 + (in.b - in.r) / delta;
-  } else {
-    temp = 4 + (in.r - in.g) / delta;
-  }
-
-  out.h = std::fmod(temp * 60, 360);  // Wrap hue to 0-360 degrees
-
-  return out;
-}
-
-RGB hsv2rgb(HSV in) {
-  RGB out;
-  double c = in.v * in.s;
-  double x = c * (1 - std::abs(fmod(in.h / 60.0, 2) - 1));
-  double m = in.v - c;
-
-  // Map colors based on hue sector
-  if (in.h >= 0 && in.h < 60) {
-    out.r = c + m;
-    out.g = x + m;
-    out.b = m;
-  } else if (in.h >= 60 && in.h < 120) {
-    out.r = x + m;
-    out.g = c + m;
-    out.b = m;
-  } else if (in.h >= 120 && in.h < 180) {
-    out.r = m;
-    out.g = c + m;
-    out.b = x + m;
-  } else if (in.h >= 180 && in.h < 240) {
-    out.r = m;
-    out.g = x + m;
-    out.b = c + m;
-  } else if (in.h >= 240 && in.h < 300) {
-    out.r = x + m;
-    out.g = m;
-    out.b = c + m;
-  } else {
-    out.r = c + m;
-    out.g = m;
-    out.b = x + m;
-  }
-
-  // Denormalize values back to 0-255 range
-  out.r = out.r * 255;
-  out.g = out.g * 255;
-  out.b = out.b * 255;
-
-  return out;
-}
-
-HSV rotate_hue(HSV in, double degrees) {
-  in.h = fmod(in.h + degrees, 360.0);  // Wrap hue to 0-360 degrees
-  return in;
-}
-
-void BananaGpu::applyCRTFilter(uint8_t& r, uint8_t& g, uint8_t& b,
-                               int currentLine) {
-  // Darken the pixels in every other line
-  if (currentLine % 2 == 0) {
-    r = r * kDarkenFactor;
-    g = g * kDarkenFactor;
-    b = b * kDarkenFactor;
-  }
-  // Add random noise
-  int noise = (rand() % kNoiseRange) - kNoiseOffset;
-
-  r = std::clamp(r + noise, 0, 255);
-  g = std::clamp(g + noise, 0, 255);
-  b = std::clamp(b + noise, 0, 255);
-}
-
-void BananaGpu::applyGrayScaleFilter(uint8_t& r, uint8_t& g, uint8_t& b) {
-  float luminance = 0.2126f * r + 0.7152f * g + 0.0722f * b;
-  r = luminance;
-  g = luminance;
-  b = luminance;
-}
-
-void BananaGpu::applyInvertFilter(uint8_t& r, uint8_t& g, uint8_t& b) {
-  r = 255 - r;
-  g = 255 - g;
-  b = 255 - b;
-}
-
-void BananaGpu::applyPastelFilter(uint8_t& r, uint8_t& g, uint8_t& b) {
-  RGB rgb;
-  HSV hsv;
-  rgb.r = r;
-  rgb.g = g;
-  rgb.b = b;
-  hsv = rgb2hsv(rgb);
-  hsv.s *= 0.6;
-  rgb = hsv2rgb(hsv);
-  r = rgb.r;
-  g = rgb.g;
-  b = rgb.b;
+int BananaGpu::getPixelOffset(int x, int y) const {
+  int pixelIndex = x + (y * width_);
+  return 2 * pixelIndex;
 }
-
-void BananaGpu::applyHueFilter(uint8_t& r, uint8_t& g, uint8_t& b) {
-  RGB rgb;
-  rgb.r = r;
-  rgb.g = g;
-  rgb.b = b;
-  rgb = hsv2rgb(rotate_hue(rgb2hsv(rgb), hue_rotation_));
-  r = rgb.r;
-  g = rgb.g;
-  b = rgb.b;
-}
-
-uint32_t BananaGpu::decodePixel(uint16_t pixelData) {
+uint32_t BananaGpu::decodePixel(uint16_t pixelData) const {
   uint8_t r = (pixelData & kRedMask) >> 10;   // Extract bits 14-10
   uint8_t g = (pixelData & kGreenMask) >> 5;  // Extract bits 9-5
   uint8_t b = (pixelData & kBlueMask);        // Extract bits 4-0
@@ -207,59 +71,91 @@ uint32_t BananaGpu::decodePixel(uint16_t pixelData) {
   g = (g * 255) / 31;
   b = (b * 255) / 31;
 
-  // if (img_enabled_) {
-  //   drawImage();
-  // }
+  return (r << 16) | (g << 8) | b;
+}
+
+// Filters run over the whole frame in this order
+void BananaGpu::configureFilters() {
+  filters_.clear();
   if (duck_enabled_) {
-    applyDuckSkin(r, g, b, current_line_, current_column_);
+    filters_.add(duckSkinKernel);
   }
   if (grayscale_enabled_) {
-    applyGrayScaleFilter(r, g, b);
+    filters_.add(grayScaleKernel);
   }
   if (invert_enabled_) {
-    applyInvertFilter(r, g, b);
+    filters_.add(invertKernel);
   }
   if (pastel_enabled_) {
-    applyPastelFilter(r, g, b);
+    filters_.add(pastelKernel);
   }
   if (hue_speed_ > 0) {
-    applyHueFilter(r, g, b);
+    filters_.add(hueKernel);
   }
   if (crt_filter_enabled_) {
-    applyCRTFilter(r, g, b, current_line_);
+    filters_.add(crtKernel);
   }
-  return (r << 16) | (g << 8) | b;
 }
 
 // 6.3 Rendering
-void BananaGpu::renderPixel(int x, int y, uint32_t color) const {
-  SDL_SetRenderDrawColor(renderer_, (color >> 16) & 0xFF, (color >> 8) & 0xFF,
-                         color & 0xFF, 0xFF);
-  SDL_RenderDrawPoint(renderer_, x, y);
-}
-
 void BananaGpu::render() {
-  SDL_RenderClear(renderer_);
-
-  // Loop through each row (Height)
-  for (int y = 0; y < kDisplayHeight; ++y) {
-    current_line_ = y;
-    // Loop through each column (Width)
-    for (int x = 0; x < kDisplayWidth; ++x) {
-      uint16_t address = getPixelAddress(x, y);
-      uint16_t pixelData = console_.read16(address);
-      uint32_t color = decodePixel(pixelData);
-      current_column_ = x;
-      renderPixel(x, y, color);
+  const uint8_t* vram = console_.frameBuffer();
+
+  // Decode the whole framebuffer, then filter it as one frame
+  for (int y = 0; y < height_; ++y) {
+    for (int x = 0; x < width_; ++x) {
+      int offset = getPixelOffset(x, y);
+      uint16_t pixelData = (vram[offset] << 8) | vram[offset + 1];
+      frame_[y * width_ + x] = decodePixel(pixelData);
     }
   }
 
+  configureFilters();
+  if (!filters_.empty()) {
+    Frame frame = {frame_.data(), width_, height_};
+    filter_context_.hue_rotation = hue_rotation_;
+    filter_context_.beginFrame(frame_number_);
+    filters_.run(frame, filter_context_);
+  }
+  ++frame_number_;
+
+  // One upload per frame instead of a draw call per pixel
+  SDL_RenderClear(renderer_);
+  if (scaler_ == ScalerId::kRenderer) {
+    SDL_UpdateTexture(texture_, NULL, frame_.data(),
+                      width_ * sizeof(uint32_t));
+    SDL_RenderCopy(renderer_, texture_, NULL, NULL);
+  } else {
+    scaleFrame(scaler_, frame_.data(), width_, height_, scaled_.data(),
+               kWindowWidth, kWindowHeight, scaler_scratch_);
+    SDL_UpdateTexture(scaled_texture_, NULL, scaled_.data(),
+                      kWindowWidth * sizeof(uint32_t));
+    SDL_RenderCopy(renderer_, scaled_texture_, NULL, NULL);
+  }
+
   hue_rotation_ += hue_speed_;
   if (img_enabled_) {
     drawImage();
   }
 }
 
+void BananaGpu::setScaler(ScalerId scaler) {
+  scaler_ = scaler;
+  if (scaler_ == ScalerId::kRenderer) {
+    SDL_RenderSetLogicalSize(renderer_, width_, height_);
+    return;
+  }
+
+  // The scaled frame is already window sized, so draw it 1:1
+  if (scaled_texture_ == NULL) {
+    scaled_texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGB888,
+                                        SDL_TEXTUREACCESS_STREAMING,
+                                        kWindowWidth, kWindowHeight);
+    scaled_.resize(kWindowWidth * kWindowHeight);
+  }
+  SDL_RenderSetLogicalSize(renderer_, kWindowWidth, kWindowHeight);
+}
+
 void BananaGpu::drawImage() {
   // If the image is enabled and it's loaded
   if (img_enabled_ && image_ != nullptr) {
@@ -281,9 +177,7 @@ void BananaGpu::saveState(std::ofstream& out) {
   out.write(reinterpret_cast<char*>(&invert_enabled_), sizeof(invert_enabled_));
   out.write(reinterpret_cast<char*>(&pastel_enabled_), sizeof(pastel_enabled_));
   out.write(reinterpret_cast<char*>(&hue_speed_), sizeof(hue_speed_));
-  out.write(reinterpret_cast<char*>(&hue_rotation_), sizeof(current_column_));
-  out.write(reinterpret_cast<char*>(&current_line_), sizeof(current_line_));
-  out.write(reinterpret_cast<char*>(&current_column_), sizeof(current_column_));
+  out.write(reinterpret_cast<char*>(&hue_rotation_), sizeof(hue_rotation_));
   // Save other necessary state variables...
 }
 
@@ -296,9 +190,7 @@ void BananaGpu::loadState(std::ifstream& in) {
   in.read(reinterpret_cast<char*>(&invert_enabled_), sizeof(invert_enabled_));
   in.read(reinterpret_cast<char*>(&pastel_enabled_), sizeof(pastel_enabled_));
   in.read(reinterpret_cast<char*>(&hue_speed_), sizeof(hue_speed_));
-  in.read(reinterpret_cast<char*>(&hue_rotation_), sizeof(current_column_));
-  in.read(reinterpret_cast<char*>(&current_line_), sizeof(current_line_));
-  in.read(reinterpret_cast<char*>(&current_column_), sizeof(current_column_));
+  in.read(reinterpret_cast<char*>(&hue_rotation_), sizeof(hue_rotation_));
   // Load other necessary state variables...
 }
 
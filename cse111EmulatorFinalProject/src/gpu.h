@@ -8,7 +8,8 @@
 #include <string>
 #include <vector>
 
-#include "duck.h"
+#include "filters.h"
+#include "scaler.h"
 
 class Console;
 
@@ -17,22 +18,36 @@ class BananaGpu {
  private:
   Console& console_;
   std::vector<uint8_t>& RAM_;
+  bool headless_;  // No SDL at all
 
-  SDL_Window* window_;
-  SDL_Renderer* renderer_;
-  SDL_Texture* texture_;
+  SDL_Window* window_ = NULL;
+  SDL_Renderer* renderer_ = NULL;
+  SDL_Texture* texture_ = NULL;
   SDL_Texture* image_ = NULL;
 
-  void renderPixel(int x, int y, uint32_t color) const;
+  std::vector<uint32_t> frame_;  // Decoded 0x00RRGGBB pixels
+  FilterPipeline filters_;
+  FilterContext filter_context_;
+  uint32_t frame_number_ = 0;
+
+  // CPU upscaling to window size (unused with ScalerId::kRenderer)
+  ScalerId scaler_ = ScalerId::kRenderer;
+  SDL_Texture* scaled_texture_ = NULL;
+  std::vector<uint32_t> scaled_;
+  std::vector<uint32_t> scaler_scratch_;
+
+  void configureFilters();
 
  public:
   // Constructor / Destructor
   BananaGpu(Console& OS, std::vector<uint8_t>& RAM);
   ~BananaGpu();
 
+  // Framebuffer size of the console's memory profile
+  int width_;
+  int height_;
+
   // State Variables
-  int current_line_;
-  int current_column_;
   bool img_enabled_ = false;
   bool duck_enabled_ = false;
   bool crt_filter_enabled_ = false;
@@ -49,36 +64,41 @@ class BananaGpu {
 
   // CRT Filter Functions
   void toggleCRTFilter() { crt_filter_enabled_ = !crt_filter_enabled_; }
-  void applyCRTFilter(uint8_t& r, uint8_t& g, uint8_t& b, int currentLine);
   // GrayScale Filter Functions
   void toggleGrayScaleFilter() { grayscale_enabled_ = !grayscale_enabled_; }
-  void applyGrayScaleFilter(uint8_t& r, uint8_t& g, uint8_t& b);
   // Invert Filter Functions
   void toggleInvertFilter() { invert_enabled_ = !invert_enabled_; }
-  void applyInvertFilter(uint8_t& r, uint8_t& g, uint8_t& b);
   // Pastel Filter Functions
   void togglePastelFilter() { pastel_enabled_ = !pastel_enabled_; }
-  void applyPastelFilter(uint8_t& r, uint8_t& g, uint8_t& b);
   // Hue Filter Functions
   void toggleHueFilter() {
     hue_speed_ = ++hue_speed_ % 5;
     std::cout << "Hue Shift Speed: " << hue_speed_ << std::endl;
   }
-  void applyHueFilter(uint8_t& r, uint8_t& g, uint8_t& b);
+
+  // Scaler Functions
+  void setScaler(ScalerId scaler);
+  void cycleScaler() {
+    setScaler(nextScaler(scaler_));
+    std::cout << "Scaler: " << scalerName(scaler_) << std::endl;
+  }
 
   // Pixel Data Handling Functions
-  int getPixelAddress(int width, int height) const;
-  uint32_t decodePixel(uint16_t pixelData);
+  int getPixelOffset(int x, int y) const;
+  uint32_t decodePixel(uint16_t pixelData) const;
 
   void render();
   void display();
   void loadImage();
 
-  // Enumeration to define display parameters
+  // Enumeration to define display parameters (the window is always the
+  // classic 64x60 framebuffer scaled up, whatever the profile's resolution)
   enum Display {
     kDisplayWidth = 64,
     kDisplayHeight = 60,
     kScaleFactor = 10,
+    kWindowWidth = kDisplayWidth * kScaleFactor,
+    kWindowHeight = kDisplayHeight * kScaleFactor,
   };
 
   // Enumeration to define RGB bit masks
@@ -88,11 +108,6 @@ class BananaGpu {
     kBlueMask = 0x001F,
   };
 
-  // Constants for the CRT Filter Effect
-  static constexpr double kDarkenFactor = 0.9;
-  static constexpr int kNoiseRange = 11;
-  static constexpr int kNoiseOffset = 5;
-
   void saveState(std::ofstream& out);
   void loadState(std::ifstream& in);
 };
\ No newline at end of file
@@ -0,0 +1,55 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "latency.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+void InputLatency::record(Clock::time_point now, uint64_t frame) {
+  pending_ = false;
+  double ms =
+      std::chrono::duration<double, std::milli>(now - event_time_).count();
+  int bucket = std::min(static_cast<int>(ms) / kBucketMs, kBuckets - 1);
+  uint64_t frames = std::min<uint64_t>(frame - event_frame_, kFrameBuckets - 1);
+
+  ++samples_;
+  total_ms_ += ms;
+  max_ms_ = std::max(max_ms_, ms);
+  ++histogram_[bucket];
+  ++frame_histogram_[frames];
+}
+
+void InputLatency::report(std::ostream &out) const {
+  if (!enabled_) {
+    return;
+  }
+  out << "Input latency: " << samples_ << " samples";
+  if (samples_ == 0) {
+    out << std::endl;
+    return;
+  }
+  out << std::fixed << std::setprecision(2) << ", mean "
+      << total_ms_ / samples_ << " ms, max " << max_ms_ << " ms\n";
+
+  uint64_t largest = *std::max_element(histogram_.begin(), histogram_.end());
+  for (int i = 0; i < kBuckets; i++) {
+    if (histogram_[i] == 0) {
+      continue;
+    }
+    std::string label = std::to_string(i * kBucketMs) + "-";
+    if (i < kBuckets - 1) {
+      label += std::to_string((i + 1) * kBucketMs);
+    }
+    out << std::setw(8) << label << " ms " << std::setw(6) << histogram_[i]
+        << " " << std::string(40 * histogram_[i] / largest, '#') << "\n";
+  }
+
+  out << "Frames from key event to controller read:";
+  for (int i = 0; i < kFrameBuckets; i++) {
+    out << " " << i << (i == kFrameBuckets - 1 ? "+" : "") << "="
+        << frame_histogram_[i];
+  }
+  out << std::endl;
+}
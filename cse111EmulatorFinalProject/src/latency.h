@@ -0,0 +1,58 @@
+// latency.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Measures input latency: the time from a controller key event to the first
+// time the ROM reads the controller register after it. Console feeds it key
+// events from controllerInput() and controller reads from read8().
+class InputLatency {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  void enable() { enabled_ = true; }
+  bool enabled() const { return enabled_; }
+
+  // A controller key changed state at `when`, during frame `frame`. Only the
+  // oldest unanswered event is timed, so bursts count once.
+  void keyEvent(Clock::time_point when, uint64_t frame) {
+    if (enabled_ && !pending_) {
+      pending_ = true;
+      event_time_ = when;
+      event_frame_ = frame;
+    }
+  }
+
+  // The ROM read the controller register during frame `frame`
+  void controllerRead(uint64_t frame) {
+    if (pending_) {
+      record(Clock::now(), frame);
+    }
+  }
+
+  void report(std::ostream &out) const;
+
+ private:
+  static constexpr int kBuckets = 25;  // 2 ms each, the last is open-ended
+  static constexpr int kBucketMs = 2;
+  static constexpr int kFrameBuckets = 5;  // 0..3 frames late, then 4+
+
+  bool enabled_ = false;
+  bool pending_ = false;
+  Clock::time_point event_time_;
+  uint64_t event_frame_ = 0;
+
+  uint64_t samples_ = 0;
+  double total_ms_ = 0.0;
+  double max_ms_ = 0.0;
+  std::array<uint64_t, kBuckets> histogram_ = {};
+  std::array<uint64_t, kFrameBuckets> frame_histogram_ = {};
+
+  void record(Clock::time_point now, uint64_t frame);
+};
@@ -1,13 +1,88 @@
 #include "console.h"
 
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <path/to/.slug_file> " << std::endl;
+  ProfileId profile = ProfileId::kClassic;
+  ScalerId scaler = ScalerId::kRenderer;
+  std::string romfile;
+  std::vector<std::string> breakpoints, watchpoints;
+  bool step = false;
+  std::string debug_input;  // Debugger commands; /dev/tty if empty
+  bool low_latency = false, measure_latency = false;
+  bool interpret = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--profile" && i + 1 < argc) {
+      if (!parseProfile(argv[++i], profile)) {
+        std::cerr << "Unknown profile: " << argv[i]
+                  << " (expected classic, banked or hires)" << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (arg == "--scaler" && i + 1 < argc) {
+      if (!parseScaler(argv[++i], scaler)) {
+        std::cerr << "Unknown scaler: " << argv[i]
+                  << " (expected renderer, nearest, epx or xbr)" << std::endl;
+        std::exit(EXIT_FAILURE);
+      }
+    } else if (arg == "--break" && i + 1 < argc) {
+      breakpoints.push_back(argv[++i]);
+    } else if (arg == "--watch" && i + 1 < argc) {
+      watchpoints.push_back(argv[++i]);
+    } else if (arg == "--debug-input" && i + 1 < argc) {
+      debug_input = argv[++i];
+    } else if (arg == "--step") {
+      step = true;
+    } else if (arg == "--low-latency") {
+      low_latency = true;
+    } else if (arg == "--input-latency") {
+      measure_latency = true;
+    } else if (arg == "--interpret") {
+      interpret = true;
+    } else if (romfile.empty()) {
+      romfile = arg;
+    } else {
+      romfile.clear();
+      break;
+    }
+  }
+  if (romfile.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--profile classic|banked|hires]"
+              << " [--scaler renderer|nearest|epx|xbr] [--break <pc>]"
+              << " [--watch <first>[-<last>][:r|w|rw]] [--step]"
+              << " [--debug-input <path>]"
+              << " [--low-latency] [--input-latency] [--interpret]"
+              << " <path/to/.slug_file> " << std::endl;
     std::exit(EXIT_FAILURE);
   }
-  std::string romfile = argv[1];
 
-  Console console(romfile);
+  Console console(romfile, profile);
+  console.setScaler(scaler);
+  console.setLowLatency(low_latency);
+  if (measure_latency) {
+    console.inputLatency().enable();
+  }
+  if (interpret) {  // Ignore any recompiled code linked in for this ROM
+    console.disableRecompiled();
+  }
+
+  BananaDebugger &debugger = console.debugger();
+  for (const std::string &spec : breakpoints) {
+    if (!debugger.parseBreakpoint(spec)) {
+      std::cerr << "Invalid breakpoint: " << spec << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  for (const std::string &spec : watchpoints) {
+    if (!debugger.parseWatchpoint(spec)) {
+      std::cerr << "Invalid watchpoint: " << spec << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  debugger.setStepping(step);
+  if (!debug_input.empty()) {
+    debugger.setCommandInput(debug_input);
+  }
 
   console.reset();
 
@@ -0,0 +1,30 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "memory.h"
+
+bool parseProfile(const std::string &name, ProfileId &profile) {
+  if (name == ClassicProfile::kName) {
+    profile = ProfileId::kClassic;
+  } else if (name == BankedProfile::kName) {
+    profile = ProfileId::kBanked;
+  } else if (name == HiResProfile::kName) {
+    profile = ProfileId::kHiRes;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::unique_ptr<MemoryController> makeMemoryController(
+    ProfileId profile, std::vector<uint8_t> &RAM) {
+  switch (profile) {
+    case ProfileId::kBanked:
+      return std::make_unique<BankedMemory<BankedProfile>>(RAM);
+    case ProfileId::kHiRes:
+      return std::make_unique<BankedMemory<HiResProfile>>(RAM);
+    case ProfileId::kClassic:
+    default:
+      return std::make_unique<BankedMemory<ClassicProfile>>(RAM);
+  }
+}
@@ -0,0 +1,192 @@
+// memory.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The CPU always sees the same 16-bit address space. A profile decides how
+// much ROM and VRAM sit behind it: ROM beyond the first 32 KB and VRAM beyond
+// the first 0x1e00 bytes are reached through bank-switch registers.
+//
+// ROM is split into 16 KB banks. Bank 0 is fixed at 0x8000-0xBFFF (it holds
+// the SLUG header), and 0xC000-0xFFFF is a window onto any other bank
+// (bank 1 after reset, so a plain 32 KB ROM looks exactly like it always has).
+// VRAM is split into 0x1e00-byte banks shown through 0x5200-0x6FFF.
+
+enum class ProfileId { kClassic, kBanked, kHiRes };
+
+struct ClassicProfile {  // 32 KB ROM, 64x60 framebuffer
+  static constexpr const char *kName = "classic";
+  static constexpr uint32_t kROMBanks = 2;
+  static constexpr uint32_t kVRAMBanks = 1;
+  static constexpr int kDisplayWidth = 64;
+  static constexpr int kDisplayHeight = 60;
+};
+
+struct BankedProfile {  // 512 KB ROM, 64x60 framebuffer
+  static constexpr const char *kName = "banked";
+  static constexpr uint32_t kROMBanks = 32;
+  static constexpr uint32_t kVRAMBanks = 1;
+  static constexpr int kDisplayWidth = 64;
+  static constexpr int kDisplayHeight = 60;
+};
+
+struct HiResProfile {  // 512 KB ROM, 128x120 framebuffer in 4 VRAM banks
+  static constexpr const char *kName = "hires";
+  static constexpr uint32_t kROMBanks = 32;
+  static constexpr uint32_t kVRAMBanks = 4;
+  static constexpr int kDisplayWidth = 128;
+  static constexpr int kDisplayHeight = 120;
+};
+
+// Cold-path interface used by Console. Reads and writes never go through
+// here: they index the flat 64 KB view directly, and a bank switch copies the
+// selected bank into its window.
+class MemoryController {
+ public:
+  virtual ~MemoryController() = default;
+
+  virtual const char *name() const = 0;
+  virtual int displayWidth() const = 0;
+  virtual int displayHeight() const = 0;
+  virtual bool fixedROM() const = 0;  // No ROM bank switching, so code is fixed
+
+  virtual bool load(const char *rom, size_t size) = 0;
+  virtual void selectROMBank(uint8_t bank) = 0;
+  virtual void selectVRAMBank(uint8_t bank) = 0;
+  virtual void clearVRAM() = 0;
+  virtual const uint8_t *frameBuffer() = 0;
+
+  virtual void saveState(std::ofstream &out) = 0;
+  virtual void loadState(std::ifstream &in) = 0;
+
+  enum Layout {
+    kVRAMWindowAddress = 0x5200,
+    kVRAMWindowSize = 0x1e00,
+    kFixedROMAddress = 0x8000,
+    kROMWindowAddress = 0xc000,
+    kROMBankSize = 0x4000,
+  };
+};
+
+template <typename Profile>
+class BankedMemory : public MemoryController {
+ private:
+  std::vector<uint8_t> &RAM_;
+  std::vector<uint8_t> rom_;
+  std::vector<uint8_t> vram_;  // Unused when the profile has one VRAM bank
+  uint8_t rom_bank_ = 1;
+  uint8_t vram_bank_ = 0;
+
+  static constexpr size_t kFrameBytes =
+      Profile::kDisplayWidth * Profile::kDisplayHeight * 2;
+  static_assert(kFrameBytes <= Profile::kVRAMBanks * kVRAMWindowSize,
+                "framebuffer does not fit in the profile's VRAM banks");
+
+ public:
+  explicit BankedMemory(std::vector<uint8_t> &RAM)
+      : RAM_(RAM),
+        rom_(Profile::kROMBanks * kROMBankSize, 0),
+        vram_(Profile::kVRAMBanks > 1 ? Profile::kVRAMBanks * kVRAMWindowSize
+                                      : 0,
+              0) {}
+
+  const char *name() const override { return Profile::kName; }
+  int displayWidth() const override { return Profile::kDisplayWidth; }
+  int displayHeight() const override { return Profile::kDisplayHeight; }
+  bool fixedROM() const override { return Profile::kROMBanks <= 2; }
+
+  bool load(const char *rom, size_t size) override {
+    if (size > rom_.size()) {
+      return false;
+    }
+    std::memcpy(rom_.data(), rom, size);
+    std::memcpy(RAM_.data() + kFixedROMAddress, rom_.data(), kROMBankSize);
+    rom_bank_ = 1;
+    mapROMBank();
+    return true;
+  }
+
+  void selectROMBank(uint8_t bank) override {
+    if constexpr (Profile::kROMBanks > 2) {
+      if (bank == rom_bank_ || bank >= Profile::kROMBanks) {
+        return;
+      }
+      rom_bank_ = bank;
+      mapROMBank();
+    }
+  }
+
+  void selectVRAMBank(uint8_t bank) override {
+    if constexpr (Profile::kVRAMBanks > 1) {
+      if (bank == vram_bank_ || bank >= Profile::kVRAMBanks) {
+        return;
+      }
+      storeVRAMWindow();
+      vram_bank_ = bank;
+      std::memcpy(RAM_.data() + kVRAMWindowAddress,
+                  vram_.data() + vram_bank_ * kVRAMWindowSize,
+                  kVRAMWindowSize);
+    }
+  }
+
+  void clearVRAM() override {
+    if constexpr (Profile::kVRAMBanks > 1) {
+      std::fill(vram_.begin(), vram_.end(), 0);
+      vram_bank_ = 0;
+    }
+  }
+
+  // With a single VRAM bank the window is the framebuffer, so this is free.
+  const uint8_t *frameBuffer() override {
+    if constexpr (Profile::kVRAMBanks > 1) {
+      storeVRAMWindow();
+      return vram_.data();
+    } else {
+      return RAM_.data() + kVRAMWindowAddress;
+    }
+  }
+
+  void saveState(std::ofstream &out) override {
+    out.write(reinterpret_cast<char *>(&rom_bank_), sizeof(rom_bank_));
+    out.write(reinterpret_cast<char *>(&vram_bank_), sizeof(vram_bank_));
+    if constexpr (Profile::kVRAMBanks > 1) {
+      storeVRAMWindow();
+      out.write(reinterpret_cast<char *>(vram_.data()), vram_.size());
+    }
+  }
+
+  void loadState(std::ifstream &in) override {
+    in.read(reinterpret_cast<char *>(&rom_bank_), sizeof(rom_bank_));
+    in.read(reinterpret_cast<char *>(&vram_bank_), sizeof(vram_bank_));
+    if constexpr (Profile::kVRAMBanks > 1) {
+      in.read(reinterpret_cast<char *>(vram_.data()), vram_.size());
+    }
+    // The saved RAM already holds the VRAM window; only ROM must be remapped.
+    mapROMBank();
+  }
+
+ private:
+  void mapROMBank() {
+    std::memcpy(RAM_.data() + kROMWindowAddress,
+                rom_.data() + rom_bank_ * kROMBankSize, kROMBankSize);
+  }
+
+  void storeVRAMWindow() {
+    std::memcpy(vram_.data() + vram_bank_ * kVRAMWindowSize,
+                RAM_.data() + kVRAMWindowAddress, kVRAMWindowSize);
+  }
+};
+
+// Profile lookup for the command line ("classic", "banked", "hires").
+bool parseProfile(const std::string &name, ProfileId &profile);
+std::unique_ptr<MemoryController> makeMemoryController(
+    ProfileId profile, std::vector<uint8_t> &RAM);
@@ -0,0 +1,328 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+// Static recompiler: translates a classic (32 KB) SLUG ROM into a C++ source
+// file with one function per basic block. Link the output into Banana (see
+// BANANA_RECOMPILED_ROMS in CMakeLists.txt) and the ROM runs natively.
+//
+// SLUG code lives in read-only memory, so whatever is reachable from setup()
+// and loop() through branches, jumps and JAL return sites can be translated
+// up front. JR targets are only known at run time; they go through the PC
+// table, and a target that is not a block leader falls back to the
+// interpreter.
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpu.h"
+#include "recompiled.h"
+
+namespace {
+
+constexpr uint32_t kCodeAddress = 0x8000;
+constexpr uint32_t kROMSize = 0x8000;
+constexpr uint32_t kSetupAddress = 0x81e0;
+constexpr uint32_t kLoopAddress = 0x81e4;
+constexpr int16_t kStopExecutionAddress = 0x7200;
+
+class Recompiler {
+ public:
+  explicit Recompiler(const std::vector<char> &rom)
+      : rom_(rom.begin(), rom.end()) {
+    rom_.resize(kROMSize, 0);  // The rest of the window reads as zero
+  }
+
+  void analyze();
+  void emit(std::ostream &out, const std::string &name, uint32_t checksum,
+            size_t size) const;
+
+  size_t blockCount() const { return leaders_.size(); }
+  size_t instructionCount() const { return reachable_.size(); }
+
+ private:
+  std::vector<uint8_t> rom_;
+  std::set<uint32_t> reachable_;  // Instruction addresses
+  std::set<uint32_t> leaders_;    // Basic block starts
+
+  uint32_t word(uint32_t addr) const {
+    uint32_t data = 0;
+    for (uint32_t i = 0; i < 4; i++) {
+      data = (data << 8) | rom_[addr - kCodeAddress + i];
+    }
+    return data;
+  }
+
+  // Where setup()/loop() start: Console passes the header word / 4 to
+  // BananaCpu::call(), whose JAL multiplies it back.
+  uint32_t entry(uint32_t header) const {
+    int16_t immediate = word(header) / 4;
+    return static_cast<uint16_t>(4 * immediate);
+  }
+
+  void emitBlock(std::ostream &out, uint32_t leader) const;
+};
+
+bool isCode(uint32_t addr) {
+  return addr >= kCodeAddress && addr < kCodeAddress + kROMSize;
+}
+
+uint32_t jumpTarget(const DecodedInstruction &d) {
+  return static_cast<uint16_t>(4 * d.immediate);
+}
+
+uint32_t branchTarget(uint32_t addr, const DecodedInstruction &d) {
+  return static_cast<uint16_t>(addr + 4 + 4 * d.immediate);
+}
+
+bool isBranch(const DecodedInstruction &d) {
+  return d.op_code == BananaCpu::kBEQ || d.op_code == BananaCpu::kBNE;
+}
+
+bool isJR(const DecodedInstruction &d) {
+  return d.op_code == BananaCpu::kFUNC && d.function == BananaCpu::kJR;
+}
+
+// A register operand; r0 is hardwired, so it reads as a constant
+std::string reg(int16_t n) {
+  return n == 0 ? "0" : "r[" + std::to_string(n) + "]";
+}
+
+// reg_a + immediate, left as an int like BananaCpu does
+std::string offset(const DecodedInstruction &d) {
+  std::ostringstream expr;
+  if (d.reg_a == 0) {
+    expr << d.immediate;
+    return expr.str();
+  }
+  expr << reg(d.reg_a);
+  if (d.immediate < 0) {
+    expr << " - " << -static_cast<int>(d.immediate);
+  } else {
+    expr << " + " << d.immediate;
+  }
+  return expr.str();
+}
+
+// reg = value. Writes to r0 are dropped, but a load still happens for its
+// IO side effects.
+void assign(std::ostream &out, int16_t dest, const std::string &value) {
+  if (dest != 0) {
+    out << "  " << reg(dest) << " = " << value << ";\n";
+  } else if (value.compare(0, 4, "cpu.") == 0) {
+    out << "  " << value << ";\n";
+  }
+}
+
+std::string hex(uint32_t value) {
+  std::ostringstream out;
+  out << "0x" << std::hex << value;
+  return out.str();
+}
+
+void Recompiler::analyze() {
+  std::vector<uint32_t> work;
+  auto visit = [&](uint32_t addr, bool leader) {
+    if (!isCode(addr)) {
+      return;  // Falls off the end of ROM or returns to the console
+    }
+    if (leader) {
+      leaders_.insert(addr);
+    }
+    if (reachable_.insert(addr).second) {
+      work.push_back(addr);
+    }
+  };
+
+  visit(entry(kSetupAddress), true);
+  visit(entry(kLoopAddress), true);
+
+  while (!work.empty()) {
+    uint32_t addr = work.back();
+    work.pop_back();
+
+    DecodedInstruction d = BananaCpu::Decode(word(addr));
+    if (isBranch(d)) {
+      visit(branchTarget(addr, d), true);
+      visit(addr + 4, true);
+    } else if (d.op_code == BananaCpu::kJ) {
+      visit(jumpTarget(d), true);
+    } else if (d.op_code == BananaCpu::kJAL) {
+      visit(jumpTarget(d), true);
+      visit(addr + 4, true);  // Return site for the callee's JR
+    } else if (!isJR(d)) {
+      visit(addr + 4, false);
+    }
+  }
+}
+
+void Recompiler::emitBlock(std::ostream &out, uint32_t leader) const {
+  out << "uint16_t block_" << std::hex << leader << std::dec
+      << "(BananaCpu &cpu) {\n"
+      // Blocks that only jump never touch a register
+      << "  [[maybe_unused]] auto &r = cpu.state_.registers;\n";
+
+  for (uint32_t addr = leader;; addr += 4) {
+    DecodedInstruction d = BananaCpu::Decode(word(addr));
+    uint32_t next = static_cast<uint16_t>(addr + 4);
+    std::string a = reg(d.reg_a);
+    std::string b = reg(d.reg_b);
+    std::string shift = std::to_string(d.shift_value);
+
+    switch (d.op_code) {
+      case BananaCpu::kFUNC:
+        switch (d.function) {
+          case BananaCpu::kSUB:
+            assign(out, d.reg_c, a + " - " + b);
+            break;
+          case BananaCpu::kSRL:
+            assign(out, d.reg_c, "(unsigned)" + b + " >> " + shift);
+            break;
+          case BananaCpu::kAND:
+            assign(out, d.reg_c, a + " & " + b);
+            break;
+          case BananaCpu::kNOR:
+            assign(out, d.reg_c, "~(" + a + " | " + b + ")");
+            break;
+          case BananaCpu::kSRA:
+            assign(out, d.reg_c, "(signed)" + b + " >> " + shift);
+            break;
+          case BananaCpu::kSLL:
+            assign(out, d.reg_c, b + " << " + shift);
+            break;
+          case BananaCpu::kJR:
+            out << "  return static_cast<uint16_t>(" << a << ");\n}\n\n";
+            return;
+          case BananaCpu::kOR:
+            assign(out, d.reg_c, a + " | " + b);
+            break;
+          case BananaCpu::kSLT:
+            assign(out, d.reg_c, "(" + a + " < " + b + ") ? 1 : 0");
+            break;
+          case BananaCpu::kADD:
+            assign(out, d.reg_c, a + " + " + b);
+            break;
+          default:  // Unknown functions are NOPs
+            break;
+        }
+        break;
+      case BananaCpu::kBEQ:
+      case BananaCpu::kBNE:
+        out << "  if (" << a << (d.op_code == BananaCpu::kBEQ ? " == " : " != ")
+            << b << ") {\n"
+            << "    return " << hex(branchTarget(addr, d)) << ";\n"
+            << "  }\n"
+            << "  return " << hex(next) << ";\n}\n\n";
+        return;
+      case BananaCpu::kSB:
+        out << "  cpu.storeByte(" << offset(d) << ", " << b << ");\n";
+        if (d.reg_a != 0 || d.immediate == kStopExecutionAddress) {
+          out << "  if (cpu.state_.halted) {\n"
+              << "    return 0;\n"
+              << "  }\n";
+        }
+        break;
+      case BananaCpu::kJAL:
+        out << "  r[31] = " << static_cast<int16_t>(addr + 4) << ";\n"
+            << "  return " << hex(jumpTarget(d)) << ";\n}\n\n";
+        return;
+      case BananaCpu::kLBU:
+        assign(out, d.reg_b, "cpu.loadByte(" + offset(d) + ")");
+        break;
+      case BananaCpu::kJ:
+        out << "  return " << hex(jumpTarget(d)) << ";\n}\n\n";
+        return;
+      case BananaCpu::kADDI:
+        assign(out, d.reg_b, offset(d));
+        break;
+      case BananaCpu::kLW:
+        assign(out, d.reg_b, "cpu.loadWord(" + offset(d) + ")");
+        break;
+      case BananaCpu::kSW:
+        out << "  cpu.storeWord(" << offset(d) << ", " << b << ");\n";
+        break;
+      default:  // Unknown opcodes are NOPs
+        break;
+    }
+
+    if (!isCode(next) || leaders_.count(next)) {
+      out << "  return " << hex(next) << ";\n}\n\n";
+      return;
+    }
+  }
+}
+
+void Recompiler::emit(std::ostream &out, const std::string &name,
+                      uint32_t checksum, size_t size) const {
+  out << "// Generated by recompile from " << name << ". Do not edit.\n"
+      << "// " << leaders_.size() << " blocks, " << reachable_.size()
+      << " instructions.\n\n"
+      << "#include <array>\n\n"
+      << "#include \"recompiled.h\"\n\n"
+      << "namespace {\n\n";
+
+  for (uint32_t leader : leaders_) {
+    emitBlock(out, leader);
+  }
+
+  out << "const std::array<RecompiledBlock, RecompiledRom::kBlockSlots> "
+         "kBlocks = [] {\n"
+      << "  std::array<RecompiledBlock, RecompiledRom::kBlockSlots> blocks "
+         "= {};\n";
+  for (uint32_t leader : leaders_) {
+    out << "  blocks[" << hex((leader - kCodeAddress) / 4) << "] = block_"
+        << std::hex << leader << std::dec << ";\n";
+  }
+  out << "  return blocks;\n"
+      << "}();\n\n"
+      << "const RecompiledRom kRom = {\"" << name << "\", " << hex(checksum)
+      << "u, " << size << "u, kBlocks.data()};\n"
+      << "const RecompiledRomRegistrar kRegistrar(kRom);\n\n"
+      << "}  // namespace\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " <path/to/.slug_file> <output.cpp>"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string romfile = argv[1];
+
+  std::ifstream file(romfile, std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Error opening file: " << romfile << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::vector<char> rom((std::istreambuf_iterator<char>(file)),
+                        std::istreambuf_iterator<char>());
+  if (rom.size() > kROMSize) {
+    // Bank switching can swap code under a block at run time
+    std::cerr << "Only classic 32 KB ROMs can be recompiled: " << romfile
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  Recompiler recompiler(rom);
+  recompiler.analyze();
+
+  std::ofstream out(argv[2]);
+  if (!out.is_open()) {
+    std::cerr << "Error opening file: " << argv[2] << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  std::string name = romfile.substr(romfile.find_last_of("/\\") + 1);
+  recompiler.emit(out, name, romChecksum(rom.data(), rom.size()), rom.size());
+
+  std::cerr << name << ": " << recompiler.blockCount() << " blocks, "
+            << recompiler.instructionCount() << " instructions" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "recompiled.h"
+
+namespace {
+
+// Function-local so registration from other translation units' static
+// initializers is safe regardless of link order
+std::vector<const RecompiledRom *> &registry() {
+  static std::vector<const RecompiledRom *> roms;
+  return roms;
+}
+
+}  // namespace
+
+uint32_t romChecksum(const char *rom, size_t size) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(rom[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+void registerRecompiledRom(const RecompiledRom &rom) {
+  registry().push_back(&rom);
+}
+
+const RecompiledRom *findRecompiledRom(const char *rom, size_t size) {
+  if (registry().empty()) {
+    return nullptr;
+  }
+  uint32_t checksum = romChecksum(rom, size);
+  for (const RecompiledRom *candidate : registry()) {
+    if (candidate->size == size && candidate->checksum == checksum) {
+      return candidate;
+    }
+  }
+  return nullptr;
+}
@@ -0,0 +1,53 @@
+// recompiled.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu.h"
+
+// ROMs translated ahead of time by the recompile tool. Each generated source
+// file holds one function per basic block and a table from PC to block, and
+// registers itself here when it is linked into Banana. Console looks the
+// loaded ROM up by checksum and, on a match, runs the blocks instead of
+// interpreting.
+
+// Runs one basic block and returns the PC it branches to
+typedef uint16_t (*RecompiledBlock)(BananaCpu &cpu);
+
+struct RecompiledRom {
+  static constexpr uint16_t kCodeAddress = 0x8000;
+  static constexpr size_t kBlockSlots = 0x8000 / 4;  // One per aligned PC
+
+  const char *name;
+  uint32_t checksum;
+  uint32_t size;
+  const RecompiledBlock *blocks;  // kBlockSlots entries, null if not a leader
+
+  // The block starting at pc, or null when pc is not a known block leader
+  // (a computed jump into untranslated code); the interpreter covers those.
+  RecompiledBlock block(uint16_t pc) const {
+    if (pc < kCodeAddress || (pc & 3) != 0) {
+      return nullptr;
+    }
+    return blocks[(pc - kCodeAddress) / 4];
+  }
+};
+
+// FNV-1a over the ROM image
+uint32_t romChecksum(const char *rom, size_t size);
+
+// Registered ROMs, and lookup of a ROM image among them
+void registerRecompiledRom(const RecompiledRom &rom);
+const RecompiledRom *findRecompiledRom(const char *rom, size_t size);
+
+// Generated files register with a static instance of this
+struct RecompiledRomRegistrar {
+  explicit RecompiledRomRegistrar(const RecompiledRom &rom) {
+    registerRecompiledRom(rom);
+  }
+};
@@ -0,0 +1,181 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#include "scaler.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+struct ScalerName {
+  ScalerId id;
+  const char *name;
+};
+
+constexpr ScalerName kScalerNames[] = {
+    {ScalerId::kRenderer, "renderer"},
+    {ScalerId::kNearest, "nearest"},
+    {ScalerId::kEPX, "epx"},
+    {ScalerId::kXBRLite, "xbr"},
+};
+
+// Weighted RGB distance; green counts most, as the eye is most sensitive to it
+int distance(uint32_t a, uint32_t b) {
+  int dr = std::abs(static_cast<int>((a >> 16) & 0xFF) -
+                    static_cast<int>((b >> 16) & 0xFF));
+  int dg = std::abs(static_cast<int>((a >> 8) & 0xFF) -
+                    static_cast<int>((b >> 8) & 0xFF));
+  int db = std::abs(static_cast<int>(a & 0xFF) - static_cast<int>(b & 0xFF));
+  return 2 * dr + 4 * dg + 3 * db;
+}
+
+uint32_t blend(uint32_t a, uint32_t b) {  // 50/50 per channel
+  return (((a ^ b) & 0x00FEFEFE) >> 1) + (a & b);
+}
+
+// Threshold below which two colors count as the same edge color
+constexpr int kSimilar = 48;
+
+// One xBR-lite corner. e is the source pixel, a and b are its neighbors on
+// either side of the corner, and diag the pixel diagonally across it. When a
+// and b are closer to each other than e is to diag, an edge runs through the
+// corner and it is blended towards the nearer of the two.
+uint32_t xbrCorner(uint32_t e, uint32_t a, uint32_t b, uint32_t diag) {
+  int edge = distance(a, b);
+  if (edge < kSimilar && edge < distance(e, diag)) {
+    return blend(e, distance(e, a) <= distance(e, b) ? a : b);
+  }
+  return e;
+}
+
+}  // namespace
+
+bool parseScaler(const std::string &name, ScalerId &scaler) {
+  for (const ScalerName &entry : kScalerNames) {
+    if (name == entry.name) {
+      scaler = entry.id;
+      return true;
+    }
+  }
+  return false;
+}
+
+const char *scalerName(ScalerId scaler) {
+  for (const ScalerName &entry : kScalerNames) {
+    if (scaler == entry.id) {
+      return entry.name;
+    }
+  }
+  return "unknown";
+}
+
+ScalerId nextScaler(ScalerId scaler) {
+  switch (scaler) {
+    case ScalerId::kRenderer:
+      return ScalerId::kNearest;
+    case ScalerId::kNearest:
+      return ScalerId::kEPX;
+    case ScalerId::kEPX:
+      return ScalerId::kXBRLite;
+    case ScalerId::kXBRLite:
+    default:
+      return ScalerId::kRenderer;
+  }
+}
+
+void scaleNearest(const uint32_t *in, int in_width, int in_height,
+                  uint32_t *out, int out_width, int out_height) {
+  std::vector<int> columns(out_width);
+  for (int x = 0; x < out_width; x++) {
+    columns[x] = x * in_width / out_width;
+  }
+
+  int previous_source = -1;
+  for (int y = 0; y < out_height; y++) {
+    uint32_t *row = out + y * out_width;
+    int source = y * in_height / out_height;
+    if (source == previous_source) {  // Repeated line: copy the one above
+      std::memcpy(row, row - out_width, out_width * sizeof(uint32_t));
+      continue;
+    }
+    const uint32_t *in_row = in + source * in_width;
+    for (int x = 0; x < out_width; x++) {
+      row[x] = in_row[columns[x]];
+    }
+    previous_source = source;
+  }
+}
+
+// Each source pixel E becomes a 2x2 block. With B above, D left, F right and
+// H below (clamped at the borders):
+//   E0 = D if D == B and B != F and D != H, else E   (and rotations)
+void scaleEPX2x(const uint32_t *in, int width, int height, uint32_t *out) {
+  int out_width = 2 * width;
+  for (int y = 0; y < height; y++) {
+    const uint32_t *row = in + y * width;
+    const uint32_t *above = in + (y > 0 ? y - 1 : y) * width;
+    const uint32_t *below = in + (y < height - 1 ? y + 1 : y) * width;
+    uint32_t *top = out + (2 * y) * out_width;
+    uint32_t *bottom = top + out_width;
+    for (int x = 0; x < width; x++) {
+      uint32_t e = row[x];
+      uint32_t b = above[x];
+      uint32_t h = below[x];
+      uint32_t d = row[x > 0 ? x - 1 : x];
+      uint32_t f = row[x < width - 1 ? x + 1 : x];
+      top[2 * x] = (d == b && b != f && d != h) ? d : e;
+      top[2 * x + 1] = (b == f && b != d && f != h) ? f : e;
+      bottom[2 * x] = (d == h && d != b && h != f) ? d : e;
+      bottom[2 * x + 1] = (h == f && d != h && b != f) ? f : e;
+    }
+  }
+}
+
+// A cut-down xBR: the same edge test as 2xBR but only over the 3x3
+// neighborhood, and corners are blended rather than copied, so diagonals
+// come out smooth instead of stair-stepped.
+void scaleXBRLite2x(const uint32_t *in, int width, int height, uint32_t *out) {
+  int out_width = 2 * width;
+  for (int y = 0; y < height; y++) {
+    const uint32_t *row = in + y * width;
+    const uint32_t *above = in + (y > 0 ? y - 1 : y) * width;
+    const uint32_t *below = in + (y < height - 1 ? y + 1 : y) * width;
+    uint32_t *top = out + (2 * y) * out_width;
+    uint32_t *bottom = top + out_width;
+    for (int x = 0; x < width; x++) {
+      int left = x > 0 ? x - 1 : x;
+      int right = x < width - 1 ? x + 1 : x;
+      uint32_t e = row[x];
+      uint32_t b = above[x], h = below[x];
+      uint32_t d = row[left], f = row[right];
+      top[2 * x] = xbrCorner(e, d, b, above[left]);
+      top[2 * x + 1] = xbrCorner(e, b, f, above[right]);
+      bottom[2 * x] = xbrCorner(e, h, d, below[left]);
+      bottom[2 * x + 1] = xbrCorner(e, f, h, below[right]);
+    }
+  }
+}
+
+void scaleFrame(ScalerId scaler, const uint32_t *in, int in_width,
+                int in_height, uint32_t *out, int out_width, int out_height,
+                std::vector<uint32_t> &scratch) {
+  switch (scaler) {
+    case ScalerId::kEPX:
+    case ScalerId::kXBRLite:
+      scratch.resize(4 * in_width * in_height);
+      if (scaler == ScalerId::kEPX) {
+        scaleEPX2x(in, in_width, in_height, scratch.data());
+      } else {
+        scaleXBRLite2x(in, in_width, in_height, scratch.data());
+      }
+      scaleNearest(scratch.data(), 2 * in_width, 2 * in_height, out,
+                   out_width, out_height);
+      break;
+    case ScalerId::kNearest:
+    case ScalerId::kRenderer:
+    default:
+      scaleNearest(in, in_width, in_height, out, out_width, out_height);
+      break;
+  }
+}
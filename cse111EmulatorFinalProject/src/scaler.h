@@ -0,0 +1,32 @@
+// scaler.h
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// CPU-side upscalers for 0x00RRGGBB frames. kRenderer leaves scaling to
+// SDL_RenderSetLogicalSize; the others produce a window-sized frame so the
+// GPU uploads one texture that needs no further scaling by the driver.
+enum class ScalerId { kRenderer, kNearest, kEPX, kXBRLite };
+
+bool parseScaler(const std::string &name, ScalerId &scaler);
+const char *scalerName(ScalerId scaler);
+ScalerId nextScaler(ScalerId scaler);
+
+// Nearest neighbor from any size to any size
+void scaleNearest(const uint32_t *in, int in_width, int in_height,
+                  uint32_t *out, int out_width, int out_height);
+
+// 2x edge-aware scalers; out must hold (2 * width) x (2 * height) pixels
+void scaleEPX2x(const uint32_t *in, int width, int height, uint32_t *out);
+void scaleXBRLite2x(const uint32_t *in, int width, int height, uint32_t *out);
+
+// Scales in to out_width x out_height with the chosen scaler. The 2x scalers
+// finish with a nearest-neighbor pass, using scratch for the 2x frame.
+void scaleFrame(ScalerId scaler, const uint32_t *in, int in_width,
+                int in_height, uint32_t *out, int out_width, int out_height,
+                std::vector<uint32_t> &scratch);
@@ -0,0 +1,61 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "scaler.h"
+
+// Times each CPU scaler on a synthetic frame:
+//   scaler_bench [width height out_width out_height iterations]
+int main(int argc, char *argv[]) {
+  int width = 64, height = 60, out_width = 640, out_height = 600;
+  int iterations = 2000;
+  if (argc == 6) {
+    width = std::atoi(argv[1]);
+    height = std::atoi(argv[2]);
+    out_width = std::atoi(argv[3]);
+    out_height = std::atoi(argv[4]);
+    iterations = std::atoi(argv[5]);
+  } else if (argc != 1) {
+    std::cerr << "Usage: " << argv[0]
+              << " [width height out_width out_height iterations]"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+
+  // Blocks, diagonals and a gradient, so every scaler takes its edge paths
+  std::vector<uint32_t> frame(width * height);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint32_t color = ((x / 8 + y / 8) % 2) ? 0xffff00 : 0x000000;
+      if (x == y || x == width - 1 - y) {
+        color = 0xffffff;
+      } else if (y > height / 2) {
+        color = (x * 255 / width) << 16 | (y * 255 / height);
+      }
+      frame[y * width + x] = color;
+    }
+  }
+
+  std::vector<uint32_t> out(out_width * out_height);
+  std::vector<uint32_t> scratch;
+  for (ScalerId scaler : {ScalerId::kNearest, ScalerId::kEPX,
+                          ScalerId::kXBRLite}) {
+    using namespace std::chrono;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++) {
+      scaleFrame(scaler, frame.data(), width, height, out.data(), out_width,
+                 out_height, scratch);
+    }
+    double elapsed =
+        duration_cast<duration<double>>(high_resolution_clock::now() - start)
+            .count();
+    std::cout << std::left << std::setw(10) << scalerName(scaler)
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(8) << elapsed * 1e6 / iterations
+              << " us/frame" << std::endl;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,216 @@
+// Copyright (c) 2024 Ethan Sifferman.
+// All rights reserved. Distribution Prohibited.
+
+// Regression runner: every directory under tests/ is a test case holding the
+// STDIN (0.in), expected STDOUT (1.out) and expected STDERR (2.out) of the
+// ROM with the same name (hello_world1 -> hws/hello_world1.slug). Each ROM
+// runs headless in this process, several at a time, and its output is
+// compared in memory.
+//
+//   run_tests [-j jobs] [--frames n] [tests_dir]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "console.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Where ROMs are looked for, relative to the directory holding tests/
+const char *const kROMDirectories[] = {"hws", "games", "gpu"};
+
+struct TestCase {
+  std::string name;
+  fs::path directory;
+  fs::path rom;
+
+  bool passed = false;
+  std::string failure;  // Why it failed, with the first differing line
+  double seconds = 0.0;
+};
+
+bool readFile(const fs::path &path, std::string &contents) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::ostringstream buffer;
+  buffer << file.rdbuf();
+  contents = buffer.str();
+  return true;
+}
+
+// Empty when equal, else the first line that differs, diff style
+std::string compare(const std::string &expected, const std::string &actual) {
+  if (expected == actual) {
+    return "";
+  }
+  std::istringstream want(expected), got(actual);
+  std::string want_line, got_line;
+  for (int line = 1;; line++) {
+    bool have_want = static_cast<bool>(std::getline(want, want_line));
+    bool have_got = static_cast<bool>(std::getline(got, got_line));
+    if (!have_want && !have_got) {  // Only a trailing newline differs
+      return "differs in the final newline";
+    }
+    if (!have_want || !have_got || want_line != got_line) {
+      std::ostringstream message;
+      message << "line " << line << "\n"
+              << "    < " << (have_want ? want_line : "(end of file)") << "\n"
+              << "    > " << (have_got ? got_line : "(end of file)");
+      return message.str();
+    }
+  }
+}
+
+void run(TestCase &test, uint64_t frame_limit) {
+  using namespace std::chrono;
+  steady_clock::time_point start = steady_clock::now();
+
+  std::string input, expected_out, expected_err;
+  if (!readFile(test.directory / "0.in", input) ||
+      !readFile(test.directory / "1.out", expected_out) ||
+      !readFile(test.directory / "2.out", expected_err)) {
+    test.failure = "missing 0.in, 1.out or 2.out";
+    return;
+  }
+
+  std::istringstream in(input);
+  std::ostringstream out, err;
+  {
+    Console console(test.rom.string(), HeadlessIO{in, out, err});
+    console.setFrameLimit(frame_limit);
+    console.reset();
+    if (!console.halted()) {
+      test.failure = "did not stop within " + std::to_string(frame_limit) +
+                     " frames";
+    }
+  }
+  test.seconds = duration<double>(steady_clock::now() - start).count();
+
+  if (!test.failure.empty()) {
+    return;
+  }
+  std::string diff = compare(expected_out, out.str());
+  if (!diff.empty()) {
+    test.failure = "stdout " + diff;
+    return;
+  }
+  diff = compare(expected_err, err.str());
+  if (!diff.empty()) {
+    test.failure = "stderr " + diff;
+    return;
+  }
+  test.passed = true;
+}
+
+std::vector<TestCase> discover(const fs::path &tests_dir) {
+  std::vector<TestCase> tests;
+  for (const fs::directory_entry &entry : fs::directory_iterator(tests_dir)) {
+    if (!entry.is_directory()) {
+      continue;
+    }
+    TestCase test;
+    test.name = entry.path().filename().string();
+    test.directory = entry.path();
+    for (const char *directory : kROMDirectories) {
+      fs::path rom =
+          tests_dir.parent_path() / directory / (test.name + ".slug");
+      if (fs::exists(rom)) {
+        test.rom = rom;
+        break;
+      }
+    }
+    tests.push_back(test);
+  }
+  std::sort(tests.begin(), tests.end(),
+            [](const TestCase &a, const TestCase &b) {
+              return a.name < b.name;
+            });
+  return tests;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+  uint64_t frame_limit = 600;  // 10 s of game time
+  fs::path tests_dir = "../tests";
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--frames" && i + 1 < argc) {
+      frame_limit = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg[0] != '-') {
+      tests_dir = arg;
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [-j jobs] [--frames n] [tests_dir]"
+                << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  if (!fs::is_directory(tests_dir)) {
+    std::cerr << "Directory " << tests_dir.string() << " does not exist"
+              << std::endl;
+    std::exit(EXIT_FAILURE);
+  }
+  tests_dir = fs::absolute(tests_dir).lexically_normal();
+  if (!tests_dir.has_filename()) {  // "tests/" -> "tests"
+    tests_dir = tests_dir.parent_path();
+  }
+
+  std::vector<TestCase> tests = discover(tests_dir);
+  using namespace std::chrono;
+  steady_clock::time_point start = steady_clock::now();
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < tests.size(); i = next++) {
+      if (tests[i].rom.empty()) {
+        tests[i].failure = "no ROM named " + tests[i].name + ".slug";
+      } else {
+        run(tests[i], frame_limit);
+      }
+    }
+  };
+  jobs = std::min<size_t>(jobs, std::max<size_t>(tests.size(), 1));
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < jobs; i++) {
+    workers.emplace_back(worker);
+  }
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+  double elapsed = duration<double>(steady_clock::now() - start).count();
+
+  int failed = 0;
+  for (const TestCase &test : tests) {
+    std::cout << (test.passed ? "PASS " : "FAIL ") << std::left
+              << std::setw(24) << test.name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(8) << test.seconds * 1e3
+              << " ms" << std::endl;
+    if (!test.passed) {
+      std::cout << "    " << test.failure << std::endl;
+      ++failed;
+    }
+  }
+  std::cout << tests.size() - failed << "/" << tests.size() << " passed in "
+            << std::fixed << std::setprecision(1) << elapsed * 1e3 << " ms ("
+            << jobs << " jobs)" << std::endl;
+
+  return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
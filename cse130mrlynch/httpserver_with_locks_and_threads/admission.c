@@ -0,0 +1,113 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "admission.h"
+
+// One address with requests in flight; count 0 marks a free slot
+typedef struct {
+    struct in6_addr addr;
+    int count;
+} client_t;
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static int limit = 0;
+static int client_limit = 0;
+static int inflight = 0;
+
+// Open addressing with linear probing.  Every address here has a
+// request in flight, so there are never more than limit of them, and
+// twice that many slots keep the probes short.
+static client_t *clients = NULL;
+static uint32_t num_slots = 0; // a power of two
+
+void admission_start(int max_inflight, int per_client) {
+    limit = max_inflight;
+    client_limit = per_client;
+    if (per_client > 0) {
+        num_slots = 1;
+        while (num_slots < 2 * (uint32_t) max_inflight) {
+            num_slots *= 2;
+        }
+        clients = calloc(num_slots, sizeof(client_t));
+        if (clients == NULL) {
+            fprintf(stderr, "Error allocating memory for admission control\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+// FNV-1a
+static uint32_t hash_addr(const struct in6_addr *addr) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < sizeof(addr->s6_addr); i++) {
+        hash ^= addr->s6_addr[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The slot holding addr, or the free slot where it would go
+static uint32_t find(const struct in6_addr *addr) {
+    uint32_t i = hash_addr(addr) & (num_slots - 1);
+    while (clients[i].count > 0 && memcmp(&clients[i].addr, addr, sizeof(*addr)) != 0) {
+        i = (i + 1) & (num_slots - 1);
+    }
+    return i;
+}
+
+// Empties slot i, moving later entries of its run back so that every
+// entry stays reachable from its home slot
+static void remove_slot(uint32_t i) {
+    uint32_t j = i;
+    while (1) {
+        clients[i].count = 0;
+        do {
+            j = (j + 1) & (num_slots - 1);
+            if (clients[j].count == 0) {
+                return;
+            }
+            // An entry may fill the hole only if its home is not in (i, j]
+        } while (((j - (hash_addr(&clients[j].addr) & (num_slots - 1))) & (num_slots - 1))
+                 < ((j - i) & (num_slots - 1)));
+        clients[i] = clients[j];
+        i = j;
+    }
+}
+
+bool admission_enter(connection_t *conn) {
+    pthread_mutex_lock(&mutex);
+    bool admitted = inflight < limit;
+    if (admitted && client_limit > 0) {
+        uint32_t i = find(&conn->peer);
+        admitted = clients[i].count < client_limit;
+        if (admitted) {
+            clients[i].addr = conn->peer;
+            clients[i].count++;
+        }
+    }
+    if (admitted) {
+        inflight++;
+    }
+    pthread_mutex_unlock(&mutex);
+    conn->admitted = admitted;
+    return admitted;
+}
+
+void admission_leave(connection_t *conn) {
+    if (!conn->admitted) {
+        return;
+    }
+    conn->admitted = false;
+    pthread_mutex_lock(&mutex);
+    inflight--;
+    if (client_limit > 0) {
+        uint32_t i = find(&conn->peer);
+        if (--clients[i].count == 0) {
+            remove_slot(i);
+        }
+    }
+    pthread_mutex_unlock(&mutex);
+}
@@ -0,0 +1,36 @@
+/**
+ * @File admission.h
+ *
+ * Admission control in front of the worker pool.  The event loop asks
+ * here before queueing a connection whose head it has read, and answers
+ * 503 at once when too many requests are already in flight, in all or
+ * from that client's address.  Turning a request away then costs one
+ * small write, where queueing it would make every client wait longer.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "connection.h"
+
+// Seconds a turned-away client is told to wait before trying again
+#define RETRY_AFTER_SECONDS 1
+
+/** @brief Sets the limits: at most max_inflight connections queued or
+ *         being served, and at most per_client of them from any one
+ *         address (0 for no such cap).
+ */
+void admission_start(int max_inflight, int per_client);
+
+/** @brief Counts conn as in flight if the limits allow it.
+ *
+ *  @return false if it should be turned away instead.
+ */
+bool admission_enter(connection_t *conn);
+
+/** @brief Stops counting conn, once a worker or the I/O thread is done
+ *         with it and it goes back to the event loop or is closed.
+ *         Does nothing for a connection that was not admitted.
+ */
+void admission_leave(connection_t *conn);
@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/time_types.h>
+
+#include "async_io.h"
+#include "admission.h"
+#include "event_loop.h"
+#include "metrics.h"
+#include "uring.h"
+#include "debug.h"
+
+#define RING_ENTRIES       256
+#define COMPLETION_ENTRIES 4096
+
+// Bytes of a file read, or of a body received, per operation
+#define CHUNK_SIZE (64 * 1024)
+
+// Matches the SO_RCVTIMEO that blocking workers get
+#define RECV_TIMEOUT_SECONDS 5
+
+// user_data of the completions that do not belong to a transfer
+#define TAG_TIMEOUT 0
+#define TAG_WAKE    1
+
+// One body in flight.  At most one operation of a transfer is queued at
+// a time; which one is told by what is staged in iov when it completes.
+typedef struct transfer {
+    connection_t *conn;
+    bool receiving; // a PUT body rather than a GET body
+    int fd; // the file read from or written to; -1 for a blob
+    cache_blob_t *blob;
+    uint64_t offset; // where in the file the body starts
+    uint64_t total; // body bytes
+    uint64_t done; // body bytes read from the file, or received
+    uint64_t written; // body bytes written to the file
+    uint64_t start;
+    int status; // 200, or 206 for one range
+
+    char header[RESPONSE_HEAD_MAX];
+    char *buf; // CHUNK_SIZE bytes of staging
+    struct iovec iov[2]; // what is still to send: header, then body; or to write: iov[1]
+    struct msghdr msg;
+    struct transfer *next;
+} transfer_t;
+
+static uring_t ring;
+static bool running = false;
+static work_queue_t *work = NULL;
+
+// Transfers the workers handed over since the I/O thread last looked
+static pthread_mutex_t incoming_lock = PTHREAD_MUTEX_INITIALIZER;
+static transfer_t *incoming = NULL;
+static int wake_fd = -1;
+static uint64_t wake_count;
+
+static const struct __kernel_timespec recv_timeout = { .tv_sec = RECV_TIMEOUT_SECONDS };
+
+static transfer_t *transfer_new(connection_t *conn, int fd, bool staging) {
+    transfer_t *transfer = calloc(1, sizeof(transfer_t));
+    if (transfer == NULL) {
+        return NULL;
+    }
+    if (staging && (transfer->buf = malloc(CHUNK_SIZE)) == NULL) {
+        free(transfer);
+        return NULL;
+    }
+    transfer->conn = conn;
+    transfer->fd = fd;
+    transfer->start = metrics_now();
+    return transfer;
+}
+
+static void transfer_delete(transfer_t *transfer) {
+    if (transfer->fd >= 0) {
+        close(transfer->fd);
+    }
+    cache_blob_release(&transfer->blob);
+    free(transfer->buf);
+    free(transfer);
+}
+
+static void hand_off(transfer_t *transfer) {
+    pthread_mutex_lock(&incoming_lock);
+    transfer->next = incoming;
+    incoming = transfer;
+    pthread_mutex_unlock(&incoming_lock);
+
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        debug("could not wake the I/O thread: %d", errno);
+    }
+}
+
+// Stages the head of the response and notes which piece of the file
+// makes up the body
+static void stage_header(
+    transfer_t *transfer, const file_version_t *version, const range_set_t *ranges) {
+    byte_range_t piece = range_piece(version, ranges, 0);
+    transfer->offset = piece.first;
+    transfer->total = piece.length;
+    transfer->status = ranges->count > 0 ? 206 : 200;
+    transfer->iov[0].iov_base = transfer->header;
+    transfer->iov[0].iov_len = connection_body_header(
+        transfer->conn, version, ranges, transfer->header, sizeof(transfer->header));
+}
+
+bool async_io_send_file(
+    connection_t *conn, int fd, const file_version_t *version, const range_set_t *ranges) {
+    transfer_t *transfer;
+    if (!running || ranges->count > 1 || (transfer = transfer_new(conn, fd, true)) == NULL) {
+        return false;
+    }
+    stage_header(transfer, version, ranges);
+    hand_off(transfer);
+    return true;
+}
+
+bool async_io_send_blob(connection_t *conn, cache_blob_t *blob, const range_set_t *ranges) {
+    transfer_t *transfer;
+    if (!running || ranges->count > 1 || (transfer = transfer_new(conn, -1, false)) == NULL) {
+        return false;
+    }
+    transfer->blob = blob;
+    stage_header(transfer, &blob->version, ranges);
+    transfer->done = transfer->total;
+    transfer->iov[1].iov_base = blob->data + transfer->offset;
+    transfer->iov[1].iov_len = transfer->total;
+    hand_off(transfer);
+    return true;
+}
+
+bool async_io_recv_file(connection_t *conn, int fd, const char *name) {
+    transfer_t *transfer;
+    // Chunked bodies are decoded by the worker
+    if (!running || !conn->has_content_length || strlen(name) >= sizeof(conn->upload_name)
+        || (transfer = transfer_new(conn, fd, true)) == NULL) {
+        return false;
+    }
+    strcpy(conn->upload_name, name);
+    transfer->receiving = true;
+    transfer->total = conn->content_length;
+
+    // Body bytes that arrived with the head are written first
+    size_t buffered = conn->len - conn->head_len;
+    if (buffered > transfer->total) {
+        buffered = transfer->total;
+    }
+    transfer->iov[1].iov_base = conn->buf + conn->head_len;
+    transfer->iov[1].iov_len = buffered;
+    transfer->done = buffered;
+    conn->consumed += buffered;
+    conn->body_received += buffered;
+    hand_off(transfer);
+    return true;
+}
+
+// Gives a connection to a worker again, as the event loop does
+static void requeue(connection_t *conn) {
+    conn->queued_at = metrics_now();
+    metrics_queue_pushed();
+    work_queue_push(work, conn);
+}
+
+static void finish_send(transfer_t *transfer, bool failed) {
+    connection_t *conn = transfer->conn;
+    if (failed) {
+        conn->keep_alive = false; // the client cannot tell where the body ended
+    }
+    metrics_response(conn->request, transfer->status);
+    metrics_stage(STAGE_SEND, transfer->start);
+    transfer_delete(transfer);
+
+    // What a worker does after a response, without tying one up for it
+    int next = connection_next_request(conn);
+    if (next == 1) {
+        requeue(conn);
+        return;
+    }
+    admission_leave(conn);
+    if (next == 0) {
+        event_loop_resume(conn);
+    } else {
+        connection_delete(&conn);
+    }
+}
+
+static void finish_recv(transfer_t *transfer, const Response_t *error) {
+    connection_t *conn = transfer->conn;
+    conn->upload_error = error;
+    metrics_stage(STAGE_IO, transfer->start);
+    transfer_delete(transfer);
+    requeue(conn); // a worker renames the file into place under the URI's lock
+}
+
+// Drops the first sent bytes from the front of iov
+static void advance(transfer_t *transfer, size_t sent) {
+    for (int i = 0; i < 2 && sent > 0; i++) {
+        size_t step = sent < transfer->iov[i].iov_len ? sent : transfer->iov[i].iov_len;
+        transfer->iov[i].iov_base = (char *) transfer->iov[i].iov_base + step;
+        transfer->iov[i].iov_len -= step;
+        sent -= step;
+    }
+}
+
+static size_t next_chunk(transfer_t *transfer) {
+    uint64_t left = transfer->total - transfer->done;
+    return left < CHUNK_SIZE ? left : CHUNK_SIZE;
+}
+
+// Queues the next operation of a GET body: send what is staged, or read
+// the next chunk of the file
+static void send_next(transfer_t *transfer) {
+    struct io_uring_sqe *sqe;
+    if (transfer->iov[0].iov_len > 0 || transfer->iov[1].iov_len > 0) {
+        int first = transfer->iov[0].iov_len == 0;
+        transfer->msg.msg_iov = &transfer->iov[first];
+        transfer->msg.msg_iovlen = 2 - first;
+        sqe = uring_prep(&ring, IORING_OP_SENDMSG, transfer->conn->fd, (uintptr_t) transfer);
+        sqe->addr = (uintptr_t) &transfer->msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    } else if (transfer->done < transfer->total) {
+        sqe = uring_prep(&ring, IORING_OP_READ, transfer->fd, (uintptr_t) transfer);
+        sqe->addr = (uintptr_t) transfer->buf;
+        sqe->len = next_chunk(transfer);
+        sqe->off = transfer->offset + transfer->done;
+    } else {
+        finish_send(transfer, false);
+    }
+}
+
+// Queues the next operation of a PUT body: write what is staged, or
+// receive the next chunk, giving up if none arrives in time
+static void recv_next(transfer_t *transfer) {
+    struct io_uring_sqe *sqe;
+    if (transfer->iov[1].iov_len > 0) {
+        sqe = uring_prep(&ring, IORING_OP_WRITE, transfer->fd, (uintptr_t) transfer);
+        sqe->addr = (uintptr_t) transfer->iov[1].iov_base;
+        sqe->len = transfer->iov[1].iov_len;
+        sqe->off = transfer->written;
+    } else if (transfer->done < transfer->total) {
+        uring_reserve(&ring, 2);
+        sqe = uring_prep(&ring, IORING_OP_RECV, transfer->conn->fd, (uintptr_t) transfer);
+        sqe->addr = (uintptr_t) transfer->buf;
+        sqe->len = next_chunk(transfer);
+        sqe->flags = IOSQE_IO_LINK;
+        sqe = uring_prep(&ring, IORING_OP_LINK_TIMEOUT, -1, TAG_TIMEOUT);
+        sqe->addr = (uintptr_t) &recv_timeout;
+        sqe->len = 1;
+    } else {
+        finish_recv(transfer, NULL);
+    }
+}
+
+static void completed(transfer_t *transfer, int result) {
+    bool staged = transfer->iov[0].iov_len > 0 || transfer->iov[1].iov_len > 0;
+    if (!transfer->receiving) {
+        if (result <= 0) {
+            finish_send(transfer, true); // client went away, or the file shrank under us
+            return;
+        }
+        if (staged) {
+            advance(transfer, result);
+        } else {
+            transfer->iov[1].iov_base = transfer->buf;
+            transfer->iov[1].iov_len = result;
+            transfer->done += result;
+        }
+        send_next(transfer);
+    } else {
+        if (staged) {
+            if (result <= 0) {
+                finish_recv(transfer, &RESPONSE_INTERNAL_SERVER_ERROR);
+                return;
+            }
+            advance(transfer, result);
+            transfer->written += result;
+        } else {
+            if (result <= 0) {
+                // 0: client stopped short of Content-Length; else timed out or failed
+                finish_recv(transfer,
+                    result == 0 ? &RESPONSE_BAD_REQUEST : &RESPONSE_INTERNAL_SERVER_ERROR);
+                return;
+            }
+            transfer->iov[1].iov_base = transfer->buf;
+            transfer->iov[1].iov_len = result;
+            transfer->done += result;
+            transfer->conn->body_received += result;
+        }
+        recv_next(transfer);
+    }
+}
+
+static void watch_wake(void) {
+    struct io_uring_sqe *sqe = uring_prep(&ring, IORING_OP_READ, wake_fd, TAG_WAKE);
+    sqe->addr = (uintptr_t) &wake_count;
+    sqe->len = sizeof(wake_count);
+}
+
+static void start_incoming(void) {
+    pthread_mutex_lock(&incoming_lock);
+    transfer_t *transfer = incoming;
+    incoming = NULL;
+    pthread_mutex_unlock(&incoming_lock);
+
+    while (transfer != NULL) {
+        transfer_t *next = transfer->next;
+        if (transfer->receiving) {
+            recv_next(transfer);
+        } else {
+            send_next(transfer);
+        }
+        transfer = next;
+    }
+}
+
+static void *io_thread(void *arg) {
+    (void) arg;
+    watch_wake();
+    while (1) {
+        int error = uring_submit(&ring, 1);
+        if (error < 0 && error != -EBUSY && error != -EAGAIN) {
+            debug("io_uring_enter failed: %d", -error);
+        }
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = uring_peek(&ring)) != NULL) {
+            uint64_t tag = cqe->user_data;
+            int result = cqe->res;
+            uring_seen(&ring);
+
+            if (tag == TAG_WAKE) {
+                start_incoming();
+                watch_wake();
+            } else if (tag != TAG_TIMEOUT) {
+                completed((transfer_t *) (uintptr_t) tag, result);
+            }
+        }
+    }
+    return NULL;
+}
+
+bool async_io_start(work_queue_t *queue) {
+    static const uint8_t ops[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_RECV,
+        IORING_OP_SENDMSG, IORING_OP_LINK_TIMEOUT };
+    int error = uring_init(&ring, RING_ENTRIES, COMPLETION_ENTRIES, ops, sizeof(ops));
+    if (error < 0) {
+        debug("io_uring unavailable (%d), the workers do their own I/O", -error);
+        return false;
+    }
+    work = queue;
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    pthread_t thread;
+    if (wake_fd < 0 || pthread_create(&thread, NULL, io_thread, NULL) != 0) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        uring_exit(&ring);
+        return false;
+    }
+    pthread_detach(thread);
+    running = true;
+    return true;
+}
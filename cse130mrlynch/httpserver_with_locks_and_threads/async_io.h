@@ -0,0 +1,57 @@
+/**
+ * @File async_io.h
+ *
+ * The optional io_uring backend (-u).  Workers still parse, lock, open
+ * and audit every request, but hand its slow part to one I/O thread
+ * that keeps every transfer in flight at once on an io_uring ring:
+ * reading a GET body from disk and sending it, and receiving a PUT body
+ * and writing it to the temp file.  A worker is then free for the next
+ * request instead of sitting in read, write or send.
+ *
+ * When io_uring is missing or disabled the backend does not start and
+ * every call below returns false, leaving the transfer to the worker.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "connection.h"
+#include "file_cache.h"
+#include "work_queue.h"
+
+/** @brief Starts the I/O thread.  Connections it is done with go back
+ *         to queue, to the event loop, or are closed.
+ *
+ *  @return Whether io_uring is usable; if not, nothing was started.
+ */
+bool async_io_start(work_queue_t *queue);
+
+/** @brief Sends version of the file open as fd, whole or the one range
+ *         in ranges, as connection_send_file does, then closes fd.
+ *
+ *  @return false if the backend is off or there are several ranges;
+ *          otherwise the I/O thread owns conn and fd from here on.
+ */
+bool async_io_send_file(
+    connection_t *conn, int fd, const file_version_t *version, const range_set_t *ranges);
+
+/** @brief Sends blob, whole or the one range in ranges, taking over the
+ *         caller's reference.
+ *
+ *  @return false if the backend is off or there are several ranges;
+ *          otherwise the I/O thread owns conn and the reference from
+ *          here on.
+ */
+bool async_io_send_blob(connection_t *conn, cache_blob_t *blob, const range_set_t *ranges);
+
+/** @brief Receives the request body into fd, the temp file named name,
+ *         then closes fd and pushes conn back onto the queue with
+ *         conn->upload_name and conn->upload_error set, so that a worker
+ *         finishes the PUT.
+ *
+ *  @return false if the backend is off; otherwise the I/O thread owns
+ *          conn and fd from here on.
+ */
+bool async_io_recv_file(connection_t *conn, int fd, const char *name);
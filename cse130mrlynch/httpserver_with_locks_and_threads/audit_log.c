@@ -0,0 +1,216 @@
+#include <sys/uio.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audit_log.h"
+
+// Lines handed to one writev; Linux takes up to 1024 iovecs
+#define BATCH_LINES 512
+
+// The writer sleeps this long at most when it sees nothing to write; a
+// producer that finds it asleep wakes it early
+#define IDLE_WAIT_NS (10 * 1000 * 1000)
+
+typedef struct {
+    uint64_t seq;
+    uint32_t len;
+    char line[AUDIT_LINE_MAX];
+} audit_record_t;
+
+// One worker's lines, oldest at tail.  Only the worker moves head and
+// only the writer moves tail; read is the writer's own cursor, ahead of
+// tail by the lines in the batch it is writing.
+typedef struct audit_ring {
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t tail;
+    uint64_t read;
+    struct audit_ring *next;
+    audit_record_t records[AUDIT_RING_SLOTS];
+} audit_ring_t;
+
+static int log_fd = -1;
+static bool direct = false; // lines are written as they are logged
+static atomic_uint_fast64_t next_seq = 0;
+
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(audit_ring_t *) rings = NULL;
+static _Thread_local audit_ring_t *my_ring = NULL;
+
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static atomic_bool writer_sleeping = false;
+
+static audit_ring_t *register_ring(void) {
+    audit_ring_t *ring = calloc(1, sizeof(audit_ring_t));
+    if (ring == NULL) {
+        fprintf(stderr, "Error allocating memory for the audit log\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_lock(&rings_lock);
+    ring->next = atomic_load(&rings);
+    atomic_store_explicit(&rings, ring, memory_order_release);
+    pthread_mutex_unlock(&rings_lock);
+    return ring;
+}
+
+static void wake_writer(void) {
+    if (atomic_load(&writer_sleeping)) {
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&wake_lock);
+    }
+}
+
+static void write_batch(struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t bytes = writev(log_fd, iov, count);
+        if (bytes < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return; // nowhere to log that the log failed
+        }
+        while (count > 0 && (size_t) bytes >= iov->iov_len) {
+            bytes -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + bytes;
+            iov->iov_len -= bytes;
+        }
+    }
+}
+
+// Formats a line into line, cutting it to AUDIT_LINE_MAX with its newline
+static uint32_t format_line(char *line, const char *format, va_list args) {
+    int len = vsnprintf(line, AUDIT_LINE_MAX, format, args);
+    if (len < 0) {
+        len = 0;
+    } else if (len >= AUDIT_LINE_MAX) {
+        len = AUDIT_LINE_MAX - 1;
+        line[len - 1] = '\n';
+    }
+    return len;
+}
+
+void audit_log(const char *format, ...) {
+    if (direct) {
+        char line[AUDIT_LINE_MAX];
+        va_list args;
+        va_start(args, format);
+        struct iovec iov = { .iov_base = line, .iov_len = format_line(line, format, args) };
+        va_end(args);
+        write_batch(&iov, 1);
+        return;
+    }
+    if (my_ring == NULL) {
+        my_ring = register_ring();
+    }
+    audit_ring_t *ring = my_ring;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // A full ring means the writer is behind; wait for room before taking
+    // a sequence number, so a taken number is always published promptly
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= AUDIT_RING_SLOTS) {
+        wake_writer();
+        sched_yield();
+    }
+
+    audit_record_t *record = &ring->records[head % AUDIT_RING_SLOTS];
+    va_list args;
+    va_start(args, format);
+    record->len = format_line(record->line, format, args);
+    va_end(args);
+
+    record->seq = atomic_fetch_add(&next_seq, 1);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_seq_cst);
+    wake_writer();
+}
+
+// The ring whose oldest unread line is number seq, if it was published
+static audit_ring_t *find_next(uint64_t seq) {
+    audit_ring_t *ring = atomic_load_explicit(&rings, memory_order_acquire);
+    for (; ring != NULL; ring = ring->next) {
+        if (ring->read < atomic_load(&ring->head)
+            && ring->records[ring->read % AUDIT_RING_SLOTS].seq == seq) {
+            return ring;
+        }
+    }
+    return NULL;
+}
+
+static void sleep_until_woken(uint64_t seq) {
+    // Dekker-style handshake with wake_writer: publish that we sleep, then
+    // look once more, so a line published meanwhile is never slept through
+    atomic_store(&writer_sleeping, true);
+    if (find_next(seq) == NULL) {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += IDLE_WAIT_NS;
+        if (until.tv_nsec >= 1000000000) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000;
+        }
+        pthread_mutex_lock(&wake_lock);
+        pthread_cond_timedwait(&wake, &wake_lock, &until);
+        pthread_mutex_unlock(&wake_lock);
+    }
+    atomic_store(&writer_sleeping, false);
+}
+
+static void *writer_thread(void *arg) {
+    (void) arg;
+    struct iovec iov[BATCH_LINES];
+    uint64_t seq = 0;
+
+    while (1) {
+        // Gather the longest run of consecutive lines that are published
+        int count = 0;
+        audit_ring_t *ring;
+        while (count < BATCH_LINES && (ring = find_next(seq)) != NULL) {
+            audit_record_t *record = &ring->records[ring->read % AUDIT_RING_SLOTS];
+            iov[count].iov_base = record->line;
+            iov[count].iov_len = record->len;
+            count++;
+            ring->read++;
+            seq++;
+        }
+
+        if (count == 0) {
+            sleep_until_woken(seq);
+            continue;
+        }
+        write_batch(iov, count);
+
+        // Hand the written slots back to their producers
+        for (ring = atomic_load_explicit(&rings, memory_order_acquire); ring != NULL;
+             ring = ring->next) {
+            atomic_store_explicit(&ring->tail, ring->read, memory_order_release);
+        }
+    }
+    return NULL;
+}
+
+void audit_log_start(int fd, bool shared) {
+    log_fd = fd;
+    if (shared) {
+        direct = true;
+        return;
+    }
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, writer_thread, NULL) != 0) {
+        fprintf(stderr, "Could not start the audit log writer\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(writer);
+}
@@ -0,0 +1,39 @@
+/**
+ * @File audit_log.h
+ *
+ * The audit log ("METHOD,/uri,status,request-id" per request) written
+ * off the request path.  Each worker formats its lines into its own
+ * single-producer ring without taking any lock, and one writer thread
+ * drains every ring to the log file with batched writev calls.
+ *
+ * Every line is stamped with a global sequence number when it is
+ * logged, and the writer emits lines strictly in that order.  Workers
+ * log while holding the URI's lock, so the file still orders the
+ * requests for each URI the way they took effect.
+ *
+ * When other processes log to the same file, whose writers could not
+ * keep one order between them, each line is instead written at once by
+ * the worker, still under the URI's lock.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+// Longest line kept; longer lines are cut and keep their newline
+#define AUDIT_LINE_MAX 256
+
+// Lines a worker may have waiting before it must wait for the writer
+#define AUDIT_RING_SLOTS 1024
+
+/** @brief Starts the writer thread, which appends to fd from then on,
+ *         or if fd is shared with other processes, has every line
+ *         written to it as it is logged.  Call once, before any thread
+ *         logs.
+ */
+void audit_log_start(int fd, bool shared);
+
+/** @brief Queues one printf-style line; format should end in "\n".
+ *         Never blocks unless this thread's ring is full.
+ */
+void audit_log(const char *format, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,720 @@
+#define _GNU_SOURCE
+
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "connection.h"
+#include "asgn2_helper_funcs.h"
+#include "debug.h"
+#include "metrics.h"
+
+#define TIMEOUT_SECONDS 5
+
+// Largest single sendfile/splice call; the kernel caps it near 2 GB anyway
+#define MAX_CHUNK (1 << 30)
+
+// Field limits of protocol.h
+#define MAX_METHOD_LENGTH 8
+#define MAX_URI_LENGTH    63
+#define MAX_KEY_LENGTH    128
+#define MAX_VALUE_LENGTH  128
+
+// Character classes of protocol.h; none of them accepts the NUL that
+// ends the head, so a scan never runs past it
+static inline bool is_method_char(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool is_token_char(unsigned char c) {
+    return is_method_char(c) || (c >= '0' && c <= '9') || c == '.' || c == '-';
+}
+
+static inline bool is_digit(unsigned char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool is_value_char(unsigned char c) {
+    return c >= ' ' && c <= '~';
+}
+
+// Length of the run of class characters at s, stopping one past max so
+// that callers can tell an overlong field from one that fits
+static inline size_t span(const char *s, size_t max, bool (*class)(unsigned char)) {
+    size_t n = 0;
+    while (n <= max && class((unsigned char) s[n])) {
+        n++;
+    }
+    return n;
+}
+
+connection_t *connection_new(int connfd) {
+    connection_t *conn = calloc(1, sizeof(connection_t));
+    if (conn == NULL) {
+        return NULL;
+    }
+    conn->fd = connfd;
+    conn->last_active = time(NULL);
+    metrics_connection_opened();
+    return conn;
+}
+
+void connection_delete(connection_t **conn) {
+    if (conn == NULL || *conn == NULL) {
+        return;
+    }
+    close((*conn)->fd);
+    free(*conn);
+    metrics_connection_closed();
+    *conn = NULL;
+}
+
+// Looks for the blank line ending the head, resuming where the last call stopped
+static bool find_head_end(connection_t *conn) {
+    size_t i = conn->scanned >= 3 ? conn->scanned - 3 : 0;
+    for (; i + 4 <= conn->len; i++) {
+        if (memcmp(conn->buf + i, "\r\n\r\n", 4) == 0) {
+            conn->head_len = i + 4;
+            return true;
+        }
+    }
+    conn->scanned = conn->len;
+    return false;
+}
+
+// Splits the head in place in a single pass: every field is
+// NUL-terminated inside buf.  Syntax errors are 400; a well-formed
+// request with an unknown method is 501 and one with another version 505.
+static const Response_t *parse_head(connection_t *conn) {
+    char *head = conn->buf;
+
+    // Request line: METHOD SP /URI SP HTTP/d.d CRLF
+    char *method = head;
+    size_t n = span(method, MAX_METHOD_LENGTH, is_method_char);
+    if (n == 0 || n > MAX_METHOD_LENGTH || method[n] != ' ' || method[n + 1] != '/') {
+        return &RESPONSE_BAD_REQUEST;
+    }
+    method[n] = '\0';
+
+    conn->uri = method + n + 2;
+    n = span(conn->uri, MAX_URI_LENGTH, is_token_char);
+    if (n == 0 || n > MAX_URI_LENGTH || conn->uri[n] != ' ') {
+        return &RESPONSE_BAD_REQUEST;
+    }
+    conn->uri[n] = '\0';
+
+    // Any character may separate the digits, as in VERSION_REGEX
+    char *version = conn->uri + n + 1;
+    if (strncmp(version, "HTTP/", 5) != 0 || !is_digit(version[5]) || version[6] == '\0'
+        || !is_digit(version[7]) || version[8] != '\r' || version[9] != '\n') {
+        return &RESPONSE_BAD_REQUEST;
+    }
+    version[8] = '\0';
+
+    // Header fields: KEY ": " VALUE CRLF, up to the empty line
+    char *line = version + 10;
+    while (line[0] != '\r' || line[1] != '\n') {
+        if (conn->num_headers == MAX_HEADERS) {
+            return &RESPONSE_BAD_REQUEST;
+        }
+        char *key = line;
+        n = span(key, MAX_KEY_LENGTH, is_token_char);
+        if (n == 0 || n > MAX_KEY_LENGTH || key[n] != ':' || key[n + 1] != ' ') {
+            return &RESPONSE_BAD_REQUEST;
+        }
+        key[n] = '\0';
+
+        char *value = key + n + 2;
+        n = span(value, MAX_VALUE_LENGTH, is_value_char);
+        if (n == 0 || n > MAX_VALUE_LENGTH || value[n] != '\r' || value[n + 1] != '\n') {
+            return &RESPONSE_BAD_REQUEST;
+        }
+        value[n] = '\0';
+
+        conn->headers[conn->num_headers].key = key;
+        conn->headers[conn->num_headers].value = value;
+        conn->num_headers++;
+        line = value + n + 2;
+    }
+
+    // The version is checked first, so an old client gets 505 for any method
+    if (strcmp(version, HTTP_VERSION_REGEX) != 0) {
+        return &RESPONSE_VERSION_NOT_SUPPORTED;
+    }
+    if (strcmp(method, "GET") == 0) {
+        conn->request = &REQUEST_GET;
+    } else if (strcmp(method, "PUT") == 0) {
+        conn->request = &REQUEST_PUT;
+    } else {
+        conn->request = &REQUEST_UNSUPPORTED;
+        return &RESPONSE_NOT_IMPLEMENTED;
+    }
+
+    const char *length = connection_get_header(conn, "Content-Length");
+    if (length != NULL) {
+        char *end = NULL;
+        errno = 0;
+        conn->content_length = strtoull(length, &end, 10);
+        if (*length < '0' || *length > '9' || *end != '\0' || errno != 0) {
+            return &RESPONSE_BAD_REQUEST;
+        }
+        conn->has_content_length = true;
+    }
+
+    // Only chunked is understood, and it cannot be mixed with a length
+    const char *coding = connection_get_header(conn, "Transfer-Encoding");
+    if (coding != NULL) {
+        if (strcasecmp(coding, "chunked") != 0) {
+            return &RESPONSE_NOT_IMPLEMENTED;
+        }
+        if (conn->has_content_length) {
+            return &RESPONSE_BAD_REQUEST;
+        }
+        conn->chunked = true;
+    }
+    if (conn->request == &REQUEST_PUT && !conn->has_content_length && !conn->chunked) {
+        return &RESPONSE_BAD_REQUEST;
+    }
+    return NULL;
+}
+
+// Whether some of the request body is still unread, so the next request
+// cannot be found on this connection
+static bool body_pending(connection_t *conn) {
+    return (conn->has_content_length && conn->body_received != conn->content_length)
+           || (conn->chunked && !conn->body_done);
+}
+
+// Parses a head that find_head_end located and decides whether the
+// connection can stay open after its response
+static void parse_buffered_head(connection_t *conn) {
+    // The parser stops at a NUL; the byte after the head may be body
+    char saved = conn->buf[conn->head_len];
+    conn->buf[conn->head_len] = '\0';
+    conn->error = parse_head(conn);
+    conn->buf[conn->head_len] = saved;
+    conn->consumed = conn->head_len;
+    conn->requests++;
+
+    const char *connection = connection_get_header(conn, "Connection");
+    // Only a PUT reads its body, so any other request that declares one
+    // leaves it in the way of the next request and must be the last
+    conn->keep_alive = conn->error == NULL && conn->requests < MAX_REQUESTS_PER_CONNECTION
+                       && (connection == NULL || strcasecmp(connection, "close") != 0)
+                       && (conn->request == &REQUEST_PUT || !body_pending(conn));
+}
+
+int connection_read_head(connection_t *conn) {
+    conn->last_active = time(NULL);
+
+    while (conn->len < MAX_HEADER_LENGTH) {
+        ssize_t bytes = read(conn->fd, conn->buf + conn->len, MAX_HEADER_LENGTH - conn->len);
+        if (bytes > 0) {
+            if (conn->head_started == 0) {
+                conn->head_started = conn->last_active;
+            }
+            conn->len += bytes;
+            if (find_head_end(conn)) {
+                parse_buffered_head(conn);
+                return 1;
+            }
+        } else if (bytes == 0) {
+            return -1; // client closed before finishing the head
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    // A full buffer without a blank line: the head is too long
+    debug("request head exceeds %d bytes", MAX_HEADER_LENGTH);
+    conn->error = &RESPONSE_BAD_REQUEST;
+    conn->keep_alive = false;
+    return 1;
+}
+
+int connection_next_request(connection_t *conn) {
+    if (!conn->keep_alive || body_pending(conn)) {
+        return -1;
+    }
+
+    // Keep only the bytes after this request, then forget its head
+    memmove(conn->buf, conn->buf + conn->consumed, conn->len - conn->consumed);
+    conn->len -= conn->consumed;
+    conn->scanned = 0;
+    conn->head_len = 0;
+    conn->consumed = 0;
+    conn->error = NULL;
+    conn->request = NULL;
+    conn->uri = NULL;
+    conn->num_headers = 0;
+    conn->content_length = 0;
+    conn->has_content_length = false;
+    conn->chunked = false;
+    conn->body_done = false;
+    conn->body_received = 0;
+    // Bytes already here from the client's pipeline start the next head now
+    conn->head_started = conn->len > 0 ? time(NULL) : 0;
+
+    if (!find_head_end(conn)) {
+        return 0;
+    }
+    parse_buffered_head(conn);
+    return 1;
+}
+
+void connection_set_blocking(connection_t *conn) {
+    int flags = fcntl(conn->fd, F_GETFL, 0);
+    fcntl(conn->fd, F_SETFL, flags & ~O_NONBLOCK);
+
+    struct timeval timeout = { .tv_sec = TIMEOUT_SECONDS, .tv_usec = 0 };
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+}
+
+void connection_set_nonblocking(connection_t *conn) {
+    int flags = fcntl(conn->fd, F_GETFL, 0);
+    fcntl(conn->fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+const char *connection_get_header(connection_t *conn, const char *header) {
+    for (int i = 0; i < conn->num_headers; i++) {
+        if (strcmp(conn->headers[i].key, header) == 0) {
+            return conn->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+void connection_send_response(connection_t *conn, const Response_t *response) {
+    uint64_t start = metrics_now();
+    if (body_pending(conn)) {
+        conn->keep_alive = false; // refused before its body was read
+    }
+    char message[256];
+    const char *text = response_get_message(response);
+    int length = snprintf(message, sizeof(message),
+        "HTTP/1.1 %u %s\r\nContent-Length: %zu\r\n%s\r\n%s\n", response_get_code(response), text,
+        strlen(text) + 1, conn->keep_alive ? "" : "Connection: close\r\n", text);
+    write_n_bytes(conn->fd, message, length);
+    metrics_response(conn->request, response_get_code(response));
+    metrics_stage(STAGE_SEND, start);
+}
+
+int connection_body_header(connection_t *conn, const file_version_t *version,
+    const range_set_t *ranges, char *header, size_t size) {
+    char etag[ETAG_MAX], date[HTTP_DATE_MAX], fields[RANGE_PART_MAX];
+    format_etag(version, etag, sizeof(etag));
+    format_http_date(version, date, sizeof(date));
+    range_header_fields(version, ranges, fields, sizeof(fields));
+    return snprintf(header, size,
+        "HTTP/1.1 %s\r\nContent-Length: %" PRIu64 "\r\n%sETag: %s\r\nLast-Modified: %s\r\n%s\r\n",
+        ranges->count > 0 ? "206 Partial Content" : "200 OK", range_body_length(version, ranges),
+        fields, etag, date, conn->keep_alive ? "" : "Connection: close\r\n");
+}
+
+void connection_send_not_modified(connection_t *conn, const file_version_t *version) {
+    uint64_t start = metrics_now();
+    char etag[ETAG_MAX], date[HTTP_DATE_MAX], message[RESPONSE_HEAD_MAX];
+    format_etag(version, etag, sizeof(etag));
+    format_http_date(version, date, sizeof(date));
+    int length = snprintf(message, sizeof(message),
+        "HTTP/1.1 304 Not Modified\r\nETag: %s\r\nLast-Modified: %s\r\n%s\r\n", etag, date,
+        conn->keep_alive ? "" : "Connection: close\r\n");
+    write_n_bytes(conn->fd, message, length);
+    metrics_response(conn->request, 304);
+    metrics_stage(STAGE_SEND, start);
+}
+
+void connection_send_unsatisfiable(connection_t *conn, const file_version_t *version) {
+    uint64_t start = metrics_now();
+    const char *text = "Range Not Satisfiable";
+    char message[256];
+    int length = snprintf(message, sizeof(message),
+        "HTTP/1.1 416 %s\r\nContent-Length: %zu\r\nContent-Range: bytes */%" PRIu64
+        "\r\n%s\r\n%s\n",
+        text, strlen(text) + 1, version->size, conn->keep_alive ? "" : "Connection: close\r\n",
+        text);
+    write_n_bytes(conn->fd, message, length);
+    metrics_response(conn->request, 416);
+    metrics_stage(STAGE_SEND, start);
+}
+
+// Holds back partial frames while corked, so the header and the start of
+// the body leave in the same segments
+static void set_cork(connection_t *conn, int on) {
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+// Moves count bytes of fd from offset through a pipe; for files sendfile
+// refuses.  Returns the bytes sent, or -1 if splice is unsupported too.
+static ssize_t splice_file(int sockfd, int fd, off_t offset, uint64_t count) {
+    int pipefd[2];
+    if (pipe(pipefd) < 0) {
+        return -1;
+    }
+
+    uint64_t sent = 0;
+    while (sent < count) {
+        size_t chunk = count - sent > MAX_CHUNK ? MAX_CHUNK : count - sent;
+        ssize_t in = splice(fd, &offset, pipefd[1], NULL, chunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in <= 0) {
+            if (in < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        while (in > 0) {
+            ssize_t out = splice(pipefd[0], NULL, sockfd, NULL, in, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out < 0 && errno == EINTR) {
+                continue;
+            }
+            if (out <= 0) {
+                close(pipefd[0]);
+                close(pipefd[1]);
+                return sent == 0 ? -1 : (ssize_t) sent;
+            }
+            in -= out;
+            sent += out;
+        }
+    }
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return sent == 0 && count > 0 ? -1 : (ssize_t) sent;
+}
+
+// Sends count bytes of fd from first without copying them through user
+// space
+static uint64_t send_body(int sockfd, int fd, uint64_t first, uint64_t count) {
+    off_t offset = (off_t) first;
+    uint64_t sent = 0;
+    while (sent < count) {
+        size_t chunk = count - sent > MAX_CHUNK ? MAX_CHUNK : count - sent;
+        ssize_t bytes = sendfile(sockfd, fd, &offset, chunk);
+        if (bytes > 0) {
+            sent += bytes;
+        } else if (bytes < 0 && errno == EINTR) {
+            continue;
+        } else if (bytes < 0 && sent == 0 && (errno == EINVAL || errno == ENOSYS)) {
+            // No sendfile for this kind of file: try splice, then plain copies
+            ssize_t spliced = splice_file(sockfd, fd, offset, count);
+            if (spliced >= 0) {
+                return spliced;
+            }
+            lseek(fd, offset, SEEK_SET);
+            spliced = pass_n_bytes(fd, sockfd, count);
+            return spliced < 0 ? 0 : (uint64_t) spliced;
+        } else {
+            break; // client went away, or the file shrank under us
+        }
+    }
+    return sent;
+}
+
+// Writes all of buf, which may be empty
+static bool send_all(connection_t *conn, char *buf, int length) {
+    return length == 0 || write_n_bytes(conn->fd, buf, length) == length;
+}
+
+const Response_t *connection_send_file(
+    connection_t *conn, int fd, const file_version_t *version, const range_set_t *ranges) {
+    uint64_t start = metrics_now();
+    char header[RESPONSE_HEAD_MAX];
+    int length = connection_body_header(conn, version, ranges, header, sizeof(header));
+
+    set_cork(conn, 1);
+    bool sent = send_all(conn, header, length);
+    char part[RANGE_PART_MAX];
+    for (int i = 0; sent && i < range_pieces(ranges); i++) {
+        byte_range_t piece = range_piece(version, ranges, i);
+        sent = send_all(conn, part, range_part_header(version, ranges, i, part, sizeof(part)))
+               && send_body(conn->fd, fd, piece.first, piece.length) == piece.length;
+    }
+    sent = sent && send_all(conn, part, range_closing(version, ranges, part, sizeof(part)));
+    set_cork(conn, 0);
+
+    const Response_t *response = NULL;
+    if (!sent) {
+        response = &RESPONSE_INTERNAL_SERVER_ERROR;
+        conn->keep_alive = false; // the client cannot tell where the body ended
+    }
+    metrics_response(conn->request, ranges->count > 0 ? 206 : 200);
+    metrics_stage(STAGE_SEND, start);
+    return response;
+}
+
+const Response_t *connection_send_data(connection_t *conn, const char *data,
+    const file_version_t *version, const range_set_t *ranges) {
+    uint64_t start = metrics_now();
+    char header[RESPONSE_HEAD_MAX];
+    char parts[MAX_RANGES + 1][RANGE_PART_MAX];
+    struct iovec iov[2 * MAX_RANGES + 2];
+    int count = 0;
+
+    // The head, then each piece after its part header, then the closing line
+    iov[count].iov_base = header;
+    iov[count++].iov_len = connection_body_header(conn, version, ranges, header, sizeof(header));
+    for (int i = 0; i < range_pieces(ranges); i++) {
+        byte_range_t piece = range_piece(version, ranges, i);
+        int length = range_part_header(version, ranges, i, parts[i], sizeof(parts[i]));
+        if (length > 0) {
+            iov[count].iov_base = parts[i];
+            iov[count++].iov_len = length;
+        }
+        iov[count].iov_base = (char *) data + piece.first;
+        iov[count++].iov_len = piece.length;
+    }
+    int length = range_closing(version, ranges, parts[MAX_RANGES], sizeof(parts[MAX_RANGES]));
+    if (length > 0) {
+        iov[count].iov_base = parts[MAX_RANGES];
+        iov[count++].iov_len = length;
+    }
+
+    int first = 0;
+    while (first < count) {
+        ssize_t bytes = writev(conn->fd, iov + first, count - first);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            conn->keep_alive = false;
+            break;
+        }
+        // Skip what was written, which may end partway through an iovec
+        while (first < count && (size_t) bytes >= iov[first].iov_len) {
+            bytes -= iov[first].iov_len;
+            first++;
+        }
+        if (first < count) {
+            iov[first].iov_base = (char *) iov[first].iov_base + bytes;
+            iov[first].iov_len -= bytes;
+        }
+    }
+    metrics_response(conn->request, ranges->count > 0 ? 206 : 200);
+    metrics_stage(STAGE_SEND, start);
+    return first < count ? &RESPONSE_INTERNAL_SERVER_ERROR : NULL;
+}
+
+void connection_send_unavailable(connection_t *conn, int retry_after) {
+    const char *text = "Service Unavailable";
+    char message[256];
+    int length = snprintf(message, sizeof(message),
+        "HTTP/1.1 503 %s\r\nContent-Length: %zu\r\nRetry-After: %d\r\n"
+        "Connection: close\r\n\r\n%s\n",
+        text, strlen(text) + 1, retry_after, text);
+    conn->keep_alive = false;
+    if (write(conn->fd, message, length) != length) {
+        debug("could not send 503 on %d", conn->fd);
+    }
+    metrics_response(conn->request, 503);
+}
+
+void connection_send_continue(connection_t *conn) {
+    const char *expect = connection_get_header(conn, "Expect");
+    if (expect == NULL || strcasecmp(expect, "100-continue") != 0
+        || conn->len > conn->consumed) {
+        return; // not asked for, or the body is already coming
+    }
+    const char *message = "HTTP/1.1 100 Continue\r\n\r\n";
+    write_n_bytes(conn->fd, (char *) message, strlen(message));
+}
+
+/** @struct chunk_reader_t
+ *  @brief A window [start, end) of bytes read from the socket but not yet
+ *         decoded.
+ */
+typedef struct {
+    connection_t *conn;
+    char buf[CHUNKED_BUFFER_SIZE];
+    size_t start;
+    size_t end;
+} chunk_reader_t;
+
+// Reads more from the socket after what is buffered, moving that to the
+// front first.  Returns false on timeout, error or end of stream.
+static bool chunk_fill(chunk_reader_t *reader) {
+    if (reader->start > 0) {
+        memmove(reader->buf, reader->buf + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+    while (1) {
+        ssize_t bytes = read(reader->conn->fd, reader->buf + reader->end,
+            CHUNKED_BUFFER_SIZE - reader->end);
+        if (bytes > 0) {
+            reader->end += bytes;
+            return true;
+        }
+        if (bytes == 0 || errno != EINTR) {
+            return false;
+        }
+    }
+}
+
+// The next CRLF-terminated line, NUL-terminated in place, or NULL if it
+// never arrives or runs past MAX_CHUNK_LINE
+static char *chunk_line(chunk_reader_t *reader) {
+    size_t scanned = 0; // bytes after start already searched
+    while (1) {
+        char *line = reader->buf + reader->start;
+        size_t len = reader->end - reader->start;
+        for (size_t i = scanned; i + 1 < len; i++) {
+            if (line[i] == '\r' && line[i + 1] == '\n') {
+                line[i] = '\0';
+                reader->start += i + 2;
+                return line;
+            }
+        }
+        if (len > MAX_CHUNK_LINE) {
+            return NULL;
+        }
+        scanned = len > 0 ? len - 1 : 0;
+        if (!chunk_fill(reader)) {
+            return NULL;
+        }
+    }
+}
+
+// Parses the hex size at the start of a chunk-size line; extensions
+// after ';' are ignored
+static bool chunk_size(const char *line, uint64_t *size) {
+    uint64_t n = 0;
+    const char *p = line;
+    for (; isxdigit((unsigned char) *p); p++) {
+        if (n > (UINT64_MAX >> 4)) {
+            return false;
+        }
+        int digit = *p <= '9' ? *p - '0' : (tolower((unsigned char) *p) - 'a' + 10);
+        n = (n << 4) | (uint64_t) digit;
+    }
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (p == line || (*p != '\0' && *p != ';')) {
+        return false;
+    }
+    *size = n;
+    return true;
+}
+
+// Decodes a chunked body into fd.  Whatever follows it in the buffer,
+// such as a pipelined request, goes back into the connection's buffer.
+static const Response_t *recv_chunked(connection_t *conn, int fd) {
+    chunk_reader_t *reader = malloc(sizeof(chunk_reader_t));
+    if (reader == NULL) {
+        return &RESPONSE_INTERNAL_SERVER_ERROR;
+    }
+    reader->conn = conn;
+    reader->start = 0;
+    reader->end = conn->len - conn->consumed;
+    memcpy(reader->buf, conn->buf + conn->consumed, reader->end);
+    conn->len = conn->consumed;
+
+    const Response_t *response = NULL;
+    while (response == NULL) {
+        uint64_t size;
+        char *line = chunk_line(reader);
+        if (line == NULL || !chunk_size(line, &size)) {
+            response = &RESPONSE_BAD_REQUEST;
+            break;
+        }
+        if (size == 0) {
+            break; // the last chunk
+        }
+
+        // Each piece is on disk before more is read
+        while (size > 0) {
+            if (reader->start == reader->end) {
+                reader->start = reader->end = 0;
+                if (!chunk_fill(reader)) {
+                    response = &RESPONSE_BAD_REQUEST;
+                    break;
+                }
+            }
+            size_t piece = reader->end - reader->start;
+            if (piece > size) {
+                piece = size;
+            }
+            if (write_n_bytes(fd, reader->buf + reader->start, piece) != (ssize_t) piece) {
+                response = &RESPONSE_INTERNAL_SERVER_ERROR;
+                break;
+            }
+            reader->start += piece;
+            size -= piece;
+            conn->body_received += piece;
+        }
+        if (response == NULL && ((line = chunk_line(reader)) == NULL || *line != '\0')) {
+            response = &RESPONSE_BAD_REQUEST; // data not followed by CRLF
+        }
+    }
+
+    // Trailer fields are read and dropped, up to the empty line
+    while (response == NULL) {
+        char *line = chunk_line(reader);
+        if (line == NULL) {
+            response = &RESPONSE_BAD_REQUEST;
+        } else if (*line == '\0') {
+            break;
+        }
+    }
+
+    if (response == NULL) {
+        conn->body_done = true;
+        size_t left = reader->end - reader->start;
+        if (left <= MAX_HEADER_LENGTH - conn->len) {
+            memcpy(conn->buf + conn->len, reader->buf + reader->start, left);
+            conn->len += left;
+        } else {
+            conn->keep_alive = false; // too much read ahead to keep
+        }
+    }
+    free(reader);
+    return response;
+}
+
+const Response_t *connection_recv_file(connection_t *conn, int fd) {
+    if (conn->chunked) {
+        return recv_chunked(conn, fd);
+    }
+    if (!conn->has_content_length) {
+        return &RESPONSE_BAD_REQUEST;
+    }
+
+    // Body bytes that arrived with the head
+    uint64_t remaining = conn->content_length;
+    size_t buffered = conn->len - conn->head_len;
+    if (buffered > remaining) {
+        buffered = remaining;
+    }
+    if (buffered > 0
+        && write_n_bytes(fd, conn->buf + conn->head_len, buffered) != (ssize_t) buffered) {
+        return &RESPONSE_INTERNAL_SERVER_ERROR;
+    }
+    conn->consumed += buffered;
+    conn->body_received += buffered;
+    remaining -= buffered;
+
+    if (remaining > 0) {
+        ssize_t passed = pass_n_bytes(conn->fd, fd, remaining);
+        if (passed < 0) {
+            return &RESPONSE_INTERNAL_SERVER_ERROR;
+        }
+        conn->body_received += passed;
+        if ((uint64_t) passed != remaining) {
+            return &RESPONSE_BAD_REQUEST; // client stopped short of Content-Length
+        }
+    }
+    return NULL;
+}
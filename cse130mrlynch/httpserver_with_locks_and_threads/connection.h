@@ -0,0 +1,236 @@
+/**
+ * @File connection.h
+ *
+ * A client connection whose request head is read and parsed
+ * incrementally on a non-blocking socket, so that the event loop can
+ * hold many slow clients while only fully parsed requests reach the
+ * worker threads.  Replaces the helper library's conn_t, which blocks
+ * on the socket until the whole head has arrived.
+ */
+
+#pragma once
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "protocol.h"
+#include "range.h"
+
+#define NUM_REQUESTS 3
+
+// Enough for a head made only of the shortest fields, "K: v\r\n"
+#define MAX_HEADERS (MAX_HEADER_LENGTH / 6)
+
+// Requests served on one connection before the server closes it
+#define MAX_REQUESTS_PER_CONNECTION 100
+
+// Room for the head of a 200 or 206 response
+#define RESPONSE_HEAD_MAX 384
+
+// Staging for a chunked request body on its way to disk
+#define CHUNKED_BUFFER_SIZE (64 * 1024)
+
+// Longest chunk-size or trailer line accepted
+#define MAX_CHUNK_LINE 256
+
+//got permission from Mitchell to use the following code
+//for proof, check Slack conversation between
+//Mitchell and Mylo Lynch 3/16/24 at 7:45 PM
+
+/**
+ * @Files request.h, response.h
+ *
+ * The response and request objects still come from the helper library.
+ *
+ * @author Andrew Quinn, Mitchell Elliott, and Gurpreet Dhillon.
+ */
+
+//response
+typedef struct Response Response_t;
+
+extern const Response_t RESPONSE_OK;
+extern const Response_t RESPONSE_CREATED;
+extern const Response_t RESPONSE_BAD_REQUEST;
+extern const Response_t RESPONSE_FORBIDDEN;
+extern const Response_t RESPONSE_NOT_FOUND;
+extern const Response_t RESPONSE_INTERNAL_SERVER_ERROR;
+extern const Response_t RESPONSE_NOT_IMPLEMENTED;
+extern const Response_t RESPONSE_VERSION_NOT_SUPPORTED;
+
+uint16_t response_get_code(const Response_t *response);
+
+const char *response_get_message(const Response_t *response);
+
+//request
+typedef struct Request Request_t;
+
+extern const Request_t REQUEST_GET;
+extern const Request_t REQUEST_PUT;
+extern const Request_t REQUEST_UNSUPPORTED;
+extern const Request_t *requests[NUM_REQUESTS];
+
+const char *request_get_str(const Request_t *);
+
+/** @struct header_t
+ *  @brief One "Key: Value" field; both point into the connection buffer.
+ */
+typedef struct {
+    char *key;
+    char *value;
+} header_t;
+
+/** @struct connection_t
+ *
+ *  @brief A connection and the request head read from it so far.  The
+ *         parsed strings all point into buf, which keeps the head
+ *         followed by whatever arrived after it: part of the body, or
+ *         the next pipelined requests.
+ */
+typedef struct connection {
+    int fd;
+    struct in6_addr peer; // client address, IPv4 mapped into IPv6
+    bool admitted; // counted by admission control until a worker is done
+
+    char buf[MAX_HEADER_LENGTH + 1];
+    size_t len; // bytes in buf
+    size_t scanned; // bytes already searched for the end of the head
+    size_t head_len; // length of the head, blank line included, once found
+    size_t consumed; // bytes of buf that belong to the current request
+
+    // Parsed request, valid once connection_read_head returns 1
+    const Response_t *error; // non-NULL if the head was malformed
+    const Request_t *request;
+    char *uri; // without the leading '/'
+    header_t headers[MAX_HEADERS];
+    int num_headers;
+    uint64_t content_length;
+    bool has_content_length;
+    bool chunked; // Transfer-Encoding: chunked instead of a Content-Length
+    bool body_done; // the last chunk and trailers have been read
+    uint64_t body_received; // body bytes read so far, decoded if chunked
+
+    // Persistent connections
+    int requests; // heads parsed on this connection
+    bool keep_alive; // false once this must be the last response
+
+    // When the event loop queued it for a worker, on the metrics clock
+    uint64_t queued_at;
+
+    // A PUT body the I/O thread received into a temp file, for a worker
+    // to rename into place; upload_name is empty otherwise
+    char upload_name[16];
+    const Response_t *upload_error;
+
+    // Idle list of the event loop; head_started is when the first byte
+    // of the head being read arrived, or 0 before it has
+    time_t last_active;
+    time_t head_started;
+    struct connection *prev;
+    struct connection *next;
+} connection_t;
+
+/** @brief Allocates a connection for connfd, which must be non-blocking
+ *         until the head has been read.
+ */
+connection_t *connection_new(int connfd);
+
+/** @brief Closes the socket and frees the connection.  Sets *conn to NULL.
+ */
+void connection_delete(connection_t **conn);
+
+/** @brief Reads whatever the socket has without blocking and parses the
+ *         head once the blank line that ends it arrives.
+ *
+ *  @return 1 when the head is complete (check conn->error), 0 when more
+ *          bytes are needed, or -1 if the client closed the connection
+ *          or the socket failed.
+ */
+int connection_read_head(connection_t *conn);
+
+/** @brief Switches the socket to blocking mode with a 5 second timeout,
+ *         as the worker threads expect.
+ */
+void connection_set_blocking(connection_t *conn);
+
+/** @brief Switches the socket back to non-blocking mode so the event
+ *         loop can wait for the next request.
+ */
+void connection_set_nonblocking(connection_t *conn);
+
+/** @brief Drops the request just served and parses the next one if its
+ *         head is already buffered, as with pipelined requests.
+ *
+ *  @return 1 when the next head is parsed and ready to serve, 0 when the
+ *          connection should wait in the event loop for more bytes, or
+ *          -1 if it must be closed: the client or the server asked for
+ *          that, or the body of the last request was not fully read.
+ */
+int connection_next_request(connection_t *conn);
+
+/** @brief The value of header, or NULL if the request did not send it.
+ */
+const char *connection_get_header(connection_t *conn, const char *header);
+
+/** @brief Sends response's status line with its message as the body.
+ *         Adds "Connection: close" if this is the last response.
+ */
+void connection_send_response(connection_t *conn, const Response_t *response);
+
+/** @brief Formats the head of the 200 response carrying version, or of
+ *         the 206 response carrying its ranges, into header
+ *         (RESPONSE_HEAD_MAX bytes).
+ *
+ *  @return The length of the head.
+ */
+int connection_body_header(connection_t *conn, const file_version_t *version,
+    const range_set_t *ranges, char *header, size_t size);
+
+/** @brief Sends version of a file, open as fd, whole with a 200 or the
+ *         ranges of it with a 206.  The body goes out with sendfile (or
+ *         splice) straight from the page cache, corked together with
+ *         the header.
+ *
+ *  @return NULL on success, or the response to report on failure.
+ */
+const Response_t *connection_send_file(
+    connection_t *conn, int fd, const file_version_t *version, const range_set_t *ranges);
+
+/** @brief Like connection_send_file, with the file's contents in data.
+ *         Sent in a single writev when the socket takes it all.
+ *
+ *  @return NULL on success, or the response to report on failure.
+ */
+const Response_t *connection_send_data(connection_t *conn, const char *data,
+    const file_version_t *version, const range_set_t *ranges);
+
+/** @brief Sends a 304 with version's validators and no body.
+ */
+void connection_send_not_modified(connection_t *conn, const file_version_t *version);
+
+/** @brief Sends a 416 for a file of version's size.
+ */
+void connection_send_unsatisfiable(connection_t *conn, const file_version_t *version);
+
+/** @brief Sends a 503 asking the client to retry after retry_after
+ *         seconds, and marks this as the last response.  For the event
+ *         loop: it does not wait for room in the socket.
+ */
+void connection_send_unavailable(connection_t *conn, int retry_after);
+
+/** @brief Sends "100 Continue" if the client sent Expect: 100-continue
+ *         and is holding the body back until it hears from the server.
+ */
+void connection_send_continue(connection_t *conn);
+
+/** @brief Receives the request body into fd, starting with the bytes
+ *         that arrived with the head: Content-Length bytes, or chunks
+ *         decoded through a CHUNKED_BUFFER_SIZE buffer until the last
+ *         one.  Nothing more is read from the socket until what was
+ *         read is on disk, so a slow disk slows the sender down.
+ *
+ *  @return NULL on success, or the response to send on failure.
+ */
+const Response_t *connection_recv_file(connection_t *conn, int fd);
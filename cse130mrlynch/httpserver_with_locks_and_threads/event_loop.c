@@ -0,0 +1,256 @@
+#define _GNU_SOURCE
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "admission.h"
+#include "connection.h"
+#include "debug.h"
+#include "metrics.h"
+
+#define MAX_EVENTS 256
+
+// Connections the workers gave back, waiting to be watched again.  The
+// eventfd wakes the loop; its epoll entry is tagged with &resume_fd.
+static pthread_mutex_t resume_lock = PTHREAD_MUTEX_INITIALIZER;
+static connection_t *resumed = NULL;
+static int resume_fd = -1;
+
+// A descriptor held in reserve: when accept runs out of descriptors, closing
+// it makes room to accept and close the waiting connections.  Edge-triggered
+// epoll would not report them again, so leaving them queued stalls the listener.
+static int spare_fd = -1;
+
+// Connections still reading their head, least recently active first
+typedef struct {
+    connection_t *head;
+    connection_t *tail;
+} idle_list_t;
+
+static void idle_remove(idle_list_t *list, connection_t *conn) {
+    if (conn->prev != NULL) {
+        conn->prev->next = conn->next;
+    } else {
+        list->head = conn->next;
+    }
+    if (conn->next != NULL) {
+        conn->next->prev = conn->prev;
+    } else {
+        list->tail = conn->prev;
+    }
+    conn->prev = conn->next = NULL;
+}
+
+static void idle_append(idle_list_t *list, connection_t *conn) {
+    conn->prev = list->tail;
+    conn->next = NULL;
+    if (list->tail != NULL) {
+        list->tail->next = conn;
+    } else {
+        list->head = conn;
+    }
+    list->tail = conn;
+}
+
+// Keeps the client's address for admission control, mapping IPv4 into IPv6
+static void note_peer(connection_t *conn, const struct sockaddr_storage *addr) {
+    if (addr->ss_family == AF_INET6) {
+        conn->peer = ((const struct sockaddr_in6 *) addr)->sin6_addr;
+    } else if (addr->ss_family == AF_INET) {
+        memset(&conn->peer, 0, sizeof(conn->peer));
+        conn->peer.s6_addr[10] = 0xff;
+        conn->peer.s6_addr[11] = 0xff;
+        memcpy(&conn->peer.s6_addr[12], &((const struct sockaddr_in *) addr)->sin_addr, 4);
+    }
+}
+
+static void accept_all(int epfd, int listenfd, idle_list_t *idle) {
+    while (1) {
+        struct sockaddr_storage addr;
+        socklen_t addr_len = sizeof(addr);
+        int connfd = accept4(
+            listenfd, (struct sockaddr *) &addr, &addr_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (connfd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && spare_fd >= 0) {
+                // accept fails this way whether or not anyone is waiting, so
+                // stop once the spare descriptor finds the queue empty
+                close(spare_fd);
+                connfd = accept(listenfd, NULL, NULL);
+                if (connfd >= 0) {
+                    debug("out of descriptors, turning a connection away");
+                    close(connfd);
+                }
+                spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                if (connfd >= 0) {
+                    continue;
+                }
+                return;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                debug("accept failed: %d", errno);
+            }
+            return;
+        }
+
+        connection_t *conn = connection_new(connfd);
+        if (conn == NULL) {
+            close(connfd);
+            continue;
+        }
+        note_peer(conn, &addr);
+        // Edge-triggered: a head that is already waiting still raises one event
+        struct epoll_event event = { .events = EPOLLIN | EPOLLET | EPOLLRDHUP, .data.ptr = conn };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, connfd, &event) < 0) {
+            connection_delete(&conn);
+            continue;
+        }
+        idle_append(idle, conn);
+    }
+}
+
+static void handle_readable(int epfd, connection_t *conn, idle_list_t *idle,
+    work_queue_t *queue, file_cache_t *cache) {
+    int status = connection_read_head(conn);
+    idle_remove(idle, conn);
+    if (status == 0) {
+        // A client that stops sending is left to expire_idle; one that keeps
+        // sending is caught here, no later than its next read
+        if (conn->head_started != 0 && conn->last_active - conn->head_started >= HEAD_TIMEOUT) {
+            epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+            connection_delete(&conn);
+            return;
+        }
+        idle_append(idle, conn); // partial head: back of the line
+        return;
+    }
+
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    if (status < 0) {
+        connection_delete(&conn);
+        return;
+    }
+
+    // Turning a request away here is cheaper than queueing it behind too many others
+    if (!admission_enter(conn)) {
+        connection_send_unavailable(conn, RETRY_AFTER_SECONDS);
+        connection_delete(&conn);
+        return;
+    }
+    connection_set_blocking(conn);
+    conn->queued_at = metrics_now();
+    metrics_queue_pushed();
+
+    // A GET of a cached file is served without touching the disk, so it goes first
+    if (conn->error == NULL && conn->request == &REQUEST_GET
+        && file_cache_contains(cache, conn->uri)) {
+        work_queue_push_urgent(queue, conn);
+    } else {
+        work_queue_push(queue, conn);
+    }
+}
+
+void event_loop_resume(connection_t *conn) {
+    connection_set_nonblocking(conn);
+
+    pthread_mutex_lock(&resume_lock);
+    conn->next = resumed;
+    resumed = conn;
+    pthread_mutex_unlock(&resume_lock);
+
+    uint64_t one = 1;
+    if (write(resume_fd, &one, sizeof(one)) < 0) {
+        debug("could not wake the event loop: %d", errno);
+    }
+}
+
+static void watch_resumed(int epfd, idle_list_t *idle) {
+    uint64_t count;
+    if (read(resume_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        debug("could not read the resume eventfd: %d", errno);
+    }
+
+    pthread_mutex_lock(&resume_lock);
+    connection_t *conn = resumed;
+    resumed = NULL;
+    pthread_mutex_unlock(&resume_lock);
+
+    time_t now = time(NULL);
+    while (conn != NULL) {
+        connection_t *next = conn->next;
+        conn->last_active = now;
+        // Adding a socket that already has bytes waiting raises an event at once
+        struct epoll_event event = { .events = EPOLLIN | EPOLLET | EPOLLRDHUP, .data.ptr = conn };
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &event) < 0) {
+            connection_delete(&conn);
+        } else {
+            idle_append(idle, conn);
+        }
+        conn = next;
+    }
+}
+
+static void expire_idle(int epfd, idle_list_t *idle) {
+    time_t now = time(NULL);
+    while (idle->head != NULL && now - idle->head->last_active >= IDLE_TIMEOUT) {
+        connection_t *conn = idle->head;
+        idle_remove(idle, conn);
+        epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+        connection_delete(&conn);
+    }
+}
+
+void event_loop_run(int listenfd, work_queue_t *queue, file_cache_t *cache) {
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0) {
+        fprintf(stderr, "Could not create epoll instance\n");
+        exit(EXIT_FAILURE);
+    }
+
+    fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL, 0) | O_NONBLOCK);
+    // The listener is the only entry without a connection
+    struct epoll_event listen_event = { .events = EPOLLIN | EPOLLET, .data.ptr = NULL };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenfd, &listen_event) < 0) {
+        fprintf(stderr, "Could not watch the listening socket\n");
+        exit(EXIT_FAILURE);
+    }
+
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    resume_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event resume_event = { .events = EPOLLIN, .data.ptr = &resume_fd };
+    if (resume_fd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, resume_fd, &resume_event) < 0) {
+        fprintf(stderr, "Could not create the resume eventfd\n");
+        exit(EXIT_FAILURE);
+    }
+
+    idle_list_t idle = { NULL, NULL };
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int ready = epoll_wait(epfd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.ptr == NULL) {
+                accept_all(epfd, listenfd, &idle);
+            } else if (events[i].data.ptr == &resume_fd) {
+                watch_resumed(epfd, &idle);
+            } else {
+                handle_readable(epfd, events[i].data.ptr, &idle, queue, cache);
+            }
+        }
+        expire_idle(epfd, &idle);
+    }
+}
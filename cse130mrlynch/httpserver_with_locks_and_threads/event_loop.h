@@ -0,0 +1,41 @@
+/**
+ * @File event_loop.h
+ *
+ * The epoll front end of the threaded server.  One thread accepts
+ * connections and reads their request heads without blocking, and only
+ * hands a connection to the worker pool once its head is complete, so
+ * slow or idle clients never tie up a worker.  Persistent connections
+ * come back to the loop between requests.
+ */
+
+#pragma once
+
+#include "work_queue.h"
+#include "connection.h"
+#include "file_cache.h"
+
+// Seconds a connection may sit without sending any part of its head,
+// including a kept-alive connection waiting for its next request
+#define IDLE_TIMEOUT 5
+
+// Seconds a client may take over one head, however steadily it trickles
+// it in, so a slow sender cannot hold a connection open by staying active
+#define HEAD_TIMEOUT 10
+
+/** @brief Runs the front end forever on listenfd, pushing each
+ *         connection_t with a complete head that admission control lets
+ *         in onto queue.  Workers own the connections they pop until they
+ *         delete them or give them back with event_loop_resume.
+ *
+ *  @param listenfd A listening socket; it is made non-blocking.
+ *
+ *  @param queue The workers' queue.
+ *
+ *  @param cache The file cache; GETs of files in it take the urgent lane.
+ */
+void event_loop_run(int listenfd, work_queue_t *queue, file_cache_t *cache);
+
+/** @brief Hands a kept-alive connection back to the running event loop
+ *         to wait for its next request.  Safe to call from any thread.
+ */
+void event_loop_resume(connection_t *conn);
@@ -0,0 +1,308 @@
+#include <sys/stat.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "file_cache.h"
+
+// Independently locked shards, each with its own LRU list and an equal
+// share of the budget; a power of two
+#define CACHE_SHARDS 16
+
+#define INITIAL_BUCKETS 64
+
+typedef struct cache_entry {
+    char *uri;
+    uint32_t hash;
+    cache_blob_t *blob;
+
+    struct cache_entry *chain; // next in the bucket
+    struct cache_entry *newer; // LRU list, most recent at the head
+    struct cache_entry *older;
+} cache_entry_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    cache_entry_t **buckets;
+    uint32_t num_buckets; // a power of two
+    uint32_t count;
+    cache_entry_t *newest;
+    cache_entry_t *oldest;
+    size_t bytes; // file data held
+    size_t budget;
+} cache_shard_t;
+
+struct file_cache {
+    size_t budget;
+    bool revalidate;
+    cache_shard_t shards[CACHE_SHARDS];
+};
+
+// FNV-1a
+static uint32_t hash_uri(const char *uri) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *) uri; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static cache_shard_t *shard_for(file_cache_t *cache, uint32_t hash) {
+    return &cache->shards[(hash >> 27) & (CACHE_SHARDS - 1)];
+}
+
+static cache_entry_t **allocate_buckets(uint32_t num_buckets) {
+    cache_entry_t **buckets = calloc(num_buckets, sizeof(cache_entry_t *));
+    if (buckets == NULL) {
+        fprintf(stderr, "Error allocating memory for the file cache\n");
+        exit(EXIT_FAILURE);
+    }
+    return buckets;
+}
+
+static void grow(cache_shard_t *shard) {
+    uint32_t num_buckets = shard->num_buckets * 2;
+    cache_entry_t **buckets = allocate_buckets(num_buckets);
+
+    for (uint32_t i = 0; i < shard->num_buckets; i++) {
+        cache_entry_t *entry = shard->buckets[i];
+        while (entry != NULL) {
+            cache_entry_t *chain = entry->chain;
+            cache_entry_t **bucket = &buckets[entry->hash & (num_buckets - 1)];
+            entry->chain = *bucket;
+            *bucket = entry;
+            entry = chain;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->num_buckets = num_buckets;
+}
+
+static cache_entry_t **find(cache_shard_t *shard, const char *uri, uint32_t hash) {
+    cache_entry_t **link = &shard->buckets[hash & (shard->num_buckets - 1)];
+    while (*link != NULL && ((*link)->hash != hash || strcmp((*link)->uri, uri) != 0)) {
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+static void lru_unlink(cache_shard_t *shard, cache_entry_t *entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        shard->newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        shard->oldest = entry->newer;
+    }
+}
+
+static void lru_push(cache_shard_t *shard, cache_entry_t *entry) {
+    entry->newer = NULL;
+    entry->older = shard->newest;
+    if (shard->newest != NULL) {
+        shard->newest->newer = entry;
+    } else {
+        shard->oldest = entry;
+    }
+    shard->newest = entry;
+}
+
+// Unlinks entry from both lists and frees it; its blob lives on while
+// other threads still hold it
+static void remove_entry(cache_shard_t *shard, cache_entry_t **link) {
+    cache_entry_t *entry = *link;
+    *link = entry->chain;
+    lru_unlink(shard, entry);
+    shard->count--;
+    shard->bytes -= entry->blob->version.size;
+
+    cache_blob_release(&entry->blob);
+    free(entry->uri);
+    free(entry);
+}
+
+file_cache_t *file_cache_new(size_t budget, bool revalidate) {
+    file_cache_t *cache = malloc(sizeof(file_cache_t));
+    if (cache == NULL) {
+        fprintf(stderr, "Error allocating memory for the file cache\n");
+        exit(EXIT_FAILURE);
+    }
+    cache->budget = budget;
+    cache->revalidate = revalidate;
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        cache_shard_t *shard = &cache->shards[i];
+        pthread_mutex_init(&shard->mutex, NULL);
+        shard->buckets = allocate_buckets(INITIAL_BUCKETS);
+        shard->num_buckets = INITIAL_BUCKETS;
+        shard->count = 0;
+        shard->newest = shard->oldest = NULL;
+        shard->bytes = 0;
+        shard->budget = budget / CACHE_SHARDS;
+    }
+    return cache;
+}
+
+void file_cache_delete(file_cache_t **cache) {
+    if (cache == NULL || *cache == NULL) {
+        return;
+    }
+    for (int i = 0; i < CACHE_SHARDS; i++) {
+        cache_shard_t *shard = &(*cache)->shards[i];
+        while (shard->oldest != NULL) {
+            cache_entry_t *entry = shard->oldest;
+            remove_entry(shard, find(shard, entry->uri, entry->hash));
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    free(*cache);
+    *cache = NULL;
+}
+
+cache_blob_t *file_cache_lookup(file_cache_t *cache, const char *uri) {
+    if (cache->budget == 0) {
+        return NULL;
+    }
+    uint32_t hash = hash_uri(uri);
+    cache_shard_t *shard = shard_for(cache, hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    cache_entry_t *entry = *find(shard, uri, hash);
+    cache_blob_t *blob = NULL;
+    if (entry != NULL) {
+        lru_unlink(shard, entry);
+        lru_push(shard, entry);
+        blob = entry->blob;
+        atomic_fetch_add(&blob->refs, 1);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+
+    if (blob != NULL && cache->revalidate) {
+        // Another process may have renamed a new version into place; the
+        // reader lock keeps it from doing so again until this GET is done
+        struct stat st;
+        file_version_t version;
+        bool current = false;
+        if (stat(uri, &st) == 0) {
+            file_version_of(&st, &version);
+            current = memcmp(&version, &blob->version, sizeof(version)) == 0;
+        }
+        if (!current) {
+            file_cache_invalidate(cache, uri);
+            cache_blob_release(&blob);
+        }
+    }
+    return blob;
+}
+
+bool file_cache_contains(file_cache_t *cache, const char *uri) {
+    if (cache->budget == 0) {
+        return false;
+    }
+    uint32_t hash = hash_uri(uri);
+    cache_shard_t *shard = shard_for(cache, hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    bool found = *find(shard, uri, hash) != NULL;
+    pthread_mutex_unlock(&shard->mutex);
+    return found;
+}
+
+bool file_cache_admits(file_cache_t *cache, uint64_t size) {
+    return cache->budget > 0 && size <= FILE_CACHE_MAX_FILE
+           && size <= cache->budget / CACHE_SHARDS;
+}
+
+cache_blob_t *file_cache_load(
+    file_cache_t *cache, const char *uri, int fd, const file_version_t *version) {
+    uint64_t size = version->size;
+    cache_blob_t *blob = malloc(sizeof(cache_blob_t) + size);
+    if (blob == NULL) {
+        return NULL;
+    }
+    // Read outside the shard lock; the URI's reader lock keeps the file still
+    uint64_t got = 0;
+    while (got < size) {
+        ssize_t bytes = pread(fd, blob->data + got, size - got, got);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            free(blob);
+            return NULL;
+        }
+        got += bytes;
+    }
+    blob->version = *version;
+    atomic_init(&blob->refs, 2); // the cache's and the caller's
+
+    uint32_t hash = hash_uri(uri);
+    cache_shard_t *shard = shard_for(cache, hash);
+    pthread_mutex_lock(&shard->mutex);
+
+    // Another reader of the same URI may have loaded it first
+    cache_entry_t **link = find(shard, uri, hash);
+    if (*link != NULL) {
+        remove_entry(shard, link);
+    }
+    while (shard->oldest != NULL && shard->bytes + size > shard->budget) {
+        cache_entry_t *oldest = shard->oldest;
+        remove_entry(shard, find(shard, oldest->uri, oldest->hash));
+    }
+
+    cache_entry_t *entry = malloc(sizeof(cache_entry_t));
+    char *key = strdup(uri);
+    if (entry == NULL || key == NULL) {
+        pthread_mutex_unlock(&shard->mutex);
+        free(entry);
+        free(key);
+        atomic_store(&blob->refs, 1);
+        return blob; // serve it without caching
+    }
+    entry->uri = key;
+    entry->hash = hash;
+    entry->blob = blob;
+    cache_entry_t **bucket = &shard->buckets[hash & (shard->num_buckets - 1)];
+    entry->chain = *bucket;
+    *bucket = entry;
+    lru_push(shard, entry);
+    shard->bytes += size;
+    if (++shard->count > shard->num_buckets) {
+        grow(shard);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return blob;
+}
+
+void file_cache_invalidate(file_cache_t *cache, const char *uri) {
+    if (cache->budget == 0) {
+        return;
+    }
+    uint32_t hash = hash_uri(uri);
+    cache_shard_t *shard = shard_for(cache, hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    cache_entry_t **link = find(shard, uri, hash);
+    if (*link != NULL) {
+        remove_entry(shard, link);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void cache_blob_release(cache_blob_t **blob) {
+    if (blob == NULL || *blob == NULL) {
+        return;
+    }
+    if (atomic_fetch_sub(&(*blob)->refs, 1) == 1) {
+        free(*blob);
+    }
+    *blob = NULL;
+}
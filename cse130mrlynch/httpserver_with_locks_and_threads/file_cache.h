@@ -0,0 +1,86 @@
+/**
+ * @File file_cache.h
+ *
+ * An in-memory copy of recently served small files, keyed by URI and
+ * kept within a byte budget by evicting the least recently used.  It is
+ * only filled and read while the URI's reader lock is held and only
+ * invalidated under its writer lock, so a GET never sees content older
+ * than the last PUT.  Files changed behind the server's back stay
+ * cached until evicted or overwritten by a PUT, unless the cache
+ * revalidates: then every hit first checks that the file on disk is
+ * still the cached version, which is what lets server processes that
+ * each have a cache see one another's PUTs.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "range.h"
+
+// Default byte budget for the whole cache
+#define FILE_CACHE_BUDGET (64 * 1024 * 1024)
+
+// Files larger than this are always sent from disk
+#define FILE_CACHE_MAX_FILE (1024 * 1024)
+
+/** @struct cache_blob_t
+ *
+ *  @brief A cached file's contents and the version they are of.
+ *         Reference counted, so a blob that is evicted while being sent
+ *         stays valid until released.
+ */
+typedef struct cache_blob {
+    atomic_int refs;
+    file_version_t version; // version.size bytes of data
+    char data[];
+} cache_blob_t;
+
+typedef struct file_cache file_cache_t;
+
+/** @brief Allocates a cache holding at most budget bytes of file data,
+ *         which checks the file on every hit if revalidate is set.  A
+ *         budget of 0 disables caching.
+ */
+file_cache_t *file_cache_new(size_t budget, bool revalidate);
+
+/** @brief Frees the cache.  Blobs still referenced stay valid until
+ *         released.  Sets *cache to NULL.
+ */
+void file_cache_delete(file_cache_t **cache);
+
+/** @brief The cached contents of uri, or NULL on a miss.  Call with
+ *         uri's reader lock held and release the blob when done.
+ */
+cache_blob_t *file_cache_lookup(file_cache_t *cache, const char *uri);
+
+/** @brief Whether uri is cached right now, without taking a reference or
+ *         counting as a use.
+ */
+bool file_cache_contains(file_cache_t *cache, const char *uri);
+
+/** @brief Whether a file of size bytes would be cached.
+ */
+bool file_cache_admits(file_cache_t *cache, uint64_t size);
+
+/** @brief Reads version's bytes from fd, which must be that version
+ *         of the file, into the cache under uri.  Call with uri's reader
+ *         lock held.
+ *
+ *  @return The new blob, to release when done, or NULL if the file
+ *          could not be read in full.
+ */
+cache_blob_t *file_cache_load(
+    file_cache_t *cache, const char *uri, int fd, const file_version_t *version);
+
+/** @brief Drops uri from the cache.  Call with uri's writer lock held,
+ *         before the file changes.
+ */
+void file_cache_invalidate(file_cache_t *cache, const char *uri);
+
+/** @brief Drops a reference to a blob.  Sets *blob to NULL.
+ */
+void cache_blob_release(cache_blob_t **blob);
@@ -1,3 +1,5 @@
+#define _GNU_SOURCE
+
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <limits.h>
@@ -8,286 +10,139 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <regex.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 #include "debug.h"
 #include "protocol.h"
-#include "queue.h"
 #include "rwlock.h"
 #include "asgn2_helper_funcs.h"
-
-#define BUFFER_SIZE 2048
-
-#define NUM_REQUESTS 3
-
-#define zero "0"
-pthread_mutex_t mutex;
-
-//got permission from Mitchell to use the following code
-//for proof, check Slack conversation between
-//Mitchell and Mylo Lynch 3/16/24 at 7:45 PM
-
-/**
- * @Files request.h, response.h, connection.h 
- *
- * confirmed I am allowed to use this code with Mitchell. Putting it directly into my httpserver.c
- *
- * @author Andrew Quinn, Mitchell Elliott, and Gurpreet Dhillon.
- */
-
-//response
-typedef struct Response Response_t;
-
-extern const Response_t RESPONSE_OK;
-extern const Response_t RESPONSE_CREATED;
-extern const Response_t RESPONSE_BAD_REQUEST;
-extern const Response_t RESPONSE_FORBIDDEN;
-extern const Response_t RESPONSE_NOT_FOUND;
-extern const Response_t RESPONSE_INTERNAL_SERVER_ERROR;
-extern const Response_t RESPONSE_NOT_IMPLEMENTED;
-extern const Response_t RESPONSE_VERSION_NOT_SUPPORTED;
-
-uint16_t response_get_code(const Response_t *response);
-
-const char *response_get_message(const Response_t *response);
-
-typedef struct Conn conn_t;
-
-//request
-//
-typedef struct Request Request_t;
-
-extern const Request_t REQUEST_GET;
-extern const Request_t REQUEST_PUT;
-extern const Request_t REQUEST_UNSUPPORTED;
-extern const Request_t *requests[NUM_REQUESTS];
-
-const char *request_get_str(const Request_t *);
-
-//connection
-conn_t *conn_new(int connfd);
-
-// Destructor
-void conn_delete(conn_t **conn);
-
-const Response_t *conn_parse(conn_t *conn);
-
-const Request_t *conn_get_request(conn_t *conn);
-
-char *conn_get_uri(conn_t *conn);
-
-char *conn_get_header(conn_t *conn, char *header);
-
-const Response_t *conn_recv_file(conn_t *conn, int fd);
-
-const Response_t *conn_send_file(conn_t *conn, int fd, uint64_t count);
-
-const Response_t *conn_send_response(conn_t *conn, const Response_t *res);
-
-char *conn_str(conn_t *conn);
-
-// Node struct
-typedef struct nodeHashTableObj *nodeHashTable;
-
-typedef struct nodeHashTableObj {
-    char *URI;
-    rwlock_t *hashLock;
-    nodeHashTable next;
-} nodeHashTableObj;
-
-// Hash table that holds Node
-typedef struct hashTableObj *hashTable;
-
-typedef struct hashTableObj {
-    nodeHashTable head;
-    int length;
-} hashTableObj;
-
-// Thread that holds Hash table
+#include "connection.h"
+#include "event_loop.h"
+#include "lock_table.h"
+#include "file_cache.h"
+#include "audit_log.h"
+#include "metrics.h"
+#include "work_queue.h"
+#include "async_io.h"
+#include "admission.h"
+#include "prefork.h"
+
+// Default length of the accept queue; the kernel caps it at somaxconn
+#define LISTEN_BACKLOG 1024
+
+// Thread that holds the URI lock table and the file cache
 typedef struct ThreadObj *Thread;
 
 typedef struct ThreadObj {
     pthread_t thread;
     int id;
-    hashTable *hashTable;
-    queue_t *queue;
+    lock_table_t *locks;
+    file_cache_t *cache;
+    work_queue_t *queue;
 } ThreadObj;
 
-void request_parser(int, hashTable);
-void handle_get(conn_t *, hashTable);
-void handle_put(conn_t *, hashTable);
-void no_coverage(conn_t *);
-
-nodeHashTable HTnode(char *uri, rwlock_t *hashLock) {
-    nodeHashTable entry = malloc(sizeof(nodeHashTableObj));
-
-    entry->URI = strdup(uri);
-    entry->hashLock = hashLock;
-    entry->next = NULL;
-
-    return entry;
-}
-
-void attach(hashTable hash, char *URI, rwlock_t *hashLock) {
-    if (hash->length == 0) {
-        nodeHashTableObj *entry_new = HTnode(URI, hashLock);
-        hash->head = entry_new;
-        hash->length++;
-    } else {
-        nodeHashTableObj *this_entry = hash->head;
-
-        while (this_entry->next != NULL) {
-            this_entry = this_entry->next;
+bool request_parser(connection_t *, lock_table_t *, file_cache_t *);
+void pin_thread(pthread_t, int);
+void no_coverage(connection_t *);
+bool parse_priority(const char *, PRIORITY *);
+bool put_forbidden(const char *);
+bool audit_put_refusal(lock_table_t *, const char *, int, const char *);
+
+// Sets *priority to the rwlock priority named by name; false for no such name
+bool parse_priority(const char *name, PRIORITY *priority) {
+    static const char *const names[] = { "readers", "writers", "nway", "adaptive" };
+    static const PRIORITY priorities[] = { READERS, WRITERS, N_WAY, ADAPTIVE };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *priority = priorities[i];
+            return true;
         }
-
-        nodeHashTableObj *entry_new = HTnode(URI, hashLock);
-        this_entry->next = entry_new;
-        hash->length++;
     }
+    return false;
 }
 
-hashTable newHT(void) {
-    hashTable htInstance = malloc(sizeof(hashTableObj));
-    if (htInstance == NULL) {
-        // Handle memory allocation failure if necessary
-        fprintf(stderr, "Error allocating memory for new hash table\n");
-        exit(EXIT_FAILURE);
-    }
-    htInstance->length = 0;
-    htInstance->head = NULL;
-
-    return htInstance;
+// Whether a PUT may not replace URI: it is a directory, or a file we may not write
+bool put_forbidden(const char *URI) {
+    struct stat target;
+    return stat(URI, &target) == 0 && (S_ISDIR(target.st_mode) || access(URI, W_OK) != 0);
 }
 
-void freeHT(hashTable *htInstance) {
-    nodeHashTable entry = (*htInstance)->head;
-    while (entry != NULL) {
-        nodeHashTable entry_n = entry->next;
-        free(entry->URI);
-        free(entry->hashLock);
-        free(entry);
-        entry = entry_n;
+// Logs a PUT that never reached the file under URI's writer lock, so its line is in
+// order with the requests that did.  A 403 is checked again under the lock first;
+// returns false, logging nothing, if the file can be replaced after all.
+bool audit_put_refusal(lock_table_t *locks, const char *URI, int code, const char *reqID) {
+    lock_entry_t *entry = lock_table_acquire(locks, URI);
+    uint64_t waited = metrics_now();
+    writer_lock(entry->lock);
+    metrics_lock_wait(1, waited);
+    bool refused = code != 403 || put_forbidden(URI);
+    if (refused) {
+        audit_log("PUT,/%s,%d,%s\n", URI, code, reqID);
     }
-
-    free(*htInstance);
-    *htInstance = NULL;
+    writer_unlock(entry->lock);
+    lock_table_release(locks, entry);
+    return refused;
 }
 
-// Last quarter audited class and went to mitchell's
-// section, saved this in my notes since I got warned this
-// would be the hardest assignments
-rwlock_t *hashLockLookup(nodeHashTable blip, char *URI) {
-
-    if (blip == NULL)
-        return NULL;
-
-    nodeHashTable entry = blip;
-
-    while (entry != NULL) {
-        if (strcmp(entry->URI, URI) == 0) {
-            return entry->hashLock;
-        }
-
-        entry = entry->next;
-    }
-
-    return NULL;
+void no_coverage(connection_t *conn) {
+    debug("handling unsupported request");
+    connection_send_response(conn, &RESPONSE_NOT_IMPLEMENTED);
 }
 
-int checkMeth(const char *str) {
-    regex_t regex;
-    int ret, method = 0;
-
-    // Compile regex for "GET "
-    if (regcomp(&regex, "^GET ", REG_EXTENDED) == 0) {
-        ret = regexec(&regex, str, 0, NULL, 0);
-        if (ret == 0) {
-            method = 1; // Match found for "GET "
-            regfree(&regex); // Free compiled regex
-            return method;
-        }
-        regfree(&regex); // Free compiled regex if no match
-    }
-
-    // Compile regex for "PUT "
-    if (regcomp(&regex, "^PUT ", REG_EXTENDED) == 0) {
-        ret = regexec(&regex, str, 0, NULL, 0);
-        if (ret == 0) {
-            method = 2; // Match found for "PUT "
-        }
-        regfree(&regex); // Free compiled regex
+// Pins a thread to the index-th CPU this process may run on, wrapping around
+void pin_thread(pthread_t thread, int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        return;
     }
-
-    return method;
-}
-
-int checkVers(const char *str) {
-    regex_t regex;
-    int ret, versionCheck = 0;
-
-    // Compile regex for "HTTP/"
-    if (regcomp(&regex, "^HTTP/", REG_EXTENDED) == 0) {
-        ret = regexec(&regex, str, 0, NULL, 0);
-        if (ret == 0) {
-            versionCheck = 1; // Match found for "HTTP/"
+    int skip = index % CPU_COUNT(&allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            if (pthread_setaffinity_np(thread, sizeof(one), &one) != 0) {
+                debug("could not pin thread %d to CPU %d", index, cpu);
+            }
+            return;
         }
-        regfree(&regex); // Free compiled regex
     }
-
-    return versionCheck;
-}
-
-void no_coverage(conn_t *conn) {
-    debug("handling unsupported request");
-    conn_send_response(conn, &RESPONSE_NOT_IMPLEMENTED);
-}
-
-bool AlphaNumeric(const char *str) {
-    regex_t regex;
-    int ret;
-    bool match;
-
-    // Compile the regular expression
-    ret = regcomp(&regex, "^[a-zA-Z0-9 .:-]+$", REG_EXTENDED);
-    if (ret) {
-        fprintf(stderr, "Could not compile regex\n");
-        return false;
-    }
-
-    // Execute the regular expression
-    ret = regexec(&regex, str, 0, NULL, 0);
-    if (!ret) {
-        match = true;
-    } else if (ret == REG_NOMATCH) {
-        match = false;
-    } else {
-        char errorMsg[256];
-        regerror(ret, &regex, errorMsg, sizeof(errorMsg));
-        fprintf(stderr, "Regex match failed: %s\n", errorMsg);
-        match = false;
-    }
-
-    // Free memory allocated to the pattern buffer by regcomp()
-    regfree(&regex);
-
-    return match;
 }
 
 // Last quarter audited class and went to mitchell's
 // section, saved this in my notes since I got warned this
 // would be the hardest assignment
 void worker_thread(Thread thread) {
-    queue_t *queue = thread->queue;
+    work_queue_t *queue = thread->queue;
 
     while (1) {
-        uintptr_t connfd = 0;
-        queue_pop(queue, (void **) &connfd);
-        request_parser((int) connfd, *thread->hashTable);
-        close((int) connfd);
+        connection_t *conn = work_queue_pop(queue, thread->id);
+        metrics_queue_popped();
+        metrics_stage(STAGE_QUEUE, conn->queued_at);
+
+        // Serve every request already buffered (pipelining), then let the
+        // event loop wait for the next one unless the connection is done
+        bool handedOff;
+        int next = 1;
+        do {
+            uint64_t start = metrics_now();
+            handedOff = request_parser(conn, thread->locks, thread->cache);
+            metrics_stage(STAGE_TOTAL, start);
+        } while (!handedOff && (next = connection_next_request(conn)) == 1);
+
+        if (handedOff) {
+            continue; // the I/O thread has it now
+        }
+        admission_leave(conn);
+        if (next == 0) {
+            event_loop_resume(conn);
+        } else {
+            connection_delete(&conn);
+        }
     }
 }
 
@@ -296,35 +151,67 @@ int main(int argc, char **argv) {
     char *fin = NULL; // Pointer to store the end character after conversion
     long port; // Variable to store the port number
     int t = 4; // Default number of threads set to 4
+    size_t cacheBytes = FILE_CACHE_BUDGET; // Byte budget of the file cache
+    int backlog = LISTEN_BACKLOG; // Length of the accept queue
+    bool pin = false; // Whether each worker is pinned to its own CPU
+    bool uring = false; // Whether bodies are transferred on io_uring
+    int maxInflight = 0; // Connections queued or served at once; 0 for all the queue holds
+    int perClient = 0; // Of those, the most from one address; 0 for no cap
+    PRIORITY priority = ADAPTIVE; // How each URI's lock orders readers and writers
+    bool priorityOk = true; // Whether -r named a priority
+    long nWay = 1; // Readers let in between writers; ADAPTIVE's floor
+    int processes = 1; // Server processes sharing the port with SO_REUSEPORT
     int opt; // Variable to store the option from getopt
-    int man = 0; // Flag to check if the thread count was manually specified
 
     // Loop through command line arguments
-    while ((opt = getopt(argc, argv, "t:")) != -1) {
+    while ((opt = getopt(argc, argv, "t:c:b:pum:i:r:n:k:")) != -1) {
         switch (opt) {
-        case 't': // If option is 't', set the thread count and mark it as manually set
+        case 't': // If option is 't', set the thread count
             t = atoi(optarg);
-            man = 1;
+            break;
+        case 'c': // If option is 'c', set the cache budget in bytes (0 turns it off)
+            cacheBytes = strtoull(optarg, NULL, 10);
+            break;
+        case 'b': // If option is 'b', set the accept backlog
+            backlog = atoi(optarg);
+            break;
+        case 'p': // If option is 'p', pin the workers to CPUs
+            pin = true;
+            break;
+        case 'u': // If option is 'u', move body transfers to the io_uring thread
+            uring = true;
+            break;
+        case 'm': // If option is 'm', set the in-flight limit past which requests get 503
+            maxInflight = atoi(optarg);
+            break;
+        case 'i': // If option is 'i', set the in-flight limit per client address
+            perClient = atoi(optarg);
+            break;
+        case 'r': // If option is 'r', set the URI locks' priority
+            priorityOk = parse_priority(optarg, &priority);
+            break;
+        case 'n': // If option is 'n', set how many readers go between writers
+            nWay = atol(optarg);
+            break;
+        case 'k': // If option is 'k', set the number of server processes
+            processes = atoi(optarg);
             break;
         default: break; // Ignore unrecognized options
         }
     }
 
-    // Validate the number of arguments
-    if (argc < 2 || (man && argc < 4)) {
-        fprintf(stderr, "Usage: %s <port> [-t threads]\n",
+    // Validate the number of arguments: the port is the one left after the options
+    if (optind >= argc || t < 1 || backlog < 1 || maxInflight < 0 || perClient < 0
+        || !priorityOk || nWay < 1 || nWay > UINT32_MAX || processes < 1) {
+        fprintf(stderr,
+            "Usage: %s [-t threads] [-c cache_bytes] [-b backlog] [-p] [-u] [-m max_inflight] "
+            "[-i per_client] [-r readers|writers|nway|adaptive] [-n readers_per_writer] "
+            "[-k processes] <port>\n",
             argv[0]); // Print usage if arguments are incorrect
         return EXIT_FAILURE; // Exit with a failure status
     }
 
-    char *portStr; // String to store the port number argument
-
-    // Determine which argument contains the port number based on if threads were manually specified
-    if (man) {
-        portStr = argv[3];
-    } else {
-        portStr = argv[1];
-    }
+    char *portStr = argv[optind]; // String to store the port number argument
 
     // Convert port string to a long integer, storing the end character in 'fin'
     port = strtol(portStr, &fin, 10);
@@ -338,222 +225,330 @@ int main(int argc, char **argv) {
     signal(
         SIGPIPE, SIG_IGN); // Ignore SIGPIPE to prevent the program from terminating on broken pipes
 
+    // With several processes, the URI locks live in memory they all share, so it is made
+    // before forking, and forking comes before any thread
+    bool shared = processes > 1;
+    lock_table_t *locks = shared ? lock_table_new_shared(priority, (uint32_t) nWay)
+                                 : lock_table_new(priority, (uint32_t) nWay);
+    int process = shared ? prefork_spawn(processes) : 0; // Only the server processes return
+
+    metrics_start(); // SIGUSR1 prints the metrics to stdout; first, so every thread blocks it
+    audit_log_start(STDERR_FILENO, shared); // Audit lines go to stderr, ordered by URI lock
+
     Listener_Socket sock; // Declare a variable for the listener socket
-    listener_init(&sock, (int) port); // Initialize the listener socket with the specified port
+    if (shared) {
+        sock.fd = prefork_listen((int) port, backlog); // One socket per process on one port
+        if (sock.fd < 0) {
+            fprintf(stderr, "Could not listen on port %ld\n", port);
+            return EXIT_FAILURE;
+        }
+    } else {
+        listener_init(&sock, (int) port); // Initialize the listener socket with the port
+        if (listen(sock.fd, backlog) < 0) { // Listening again only resizes the accept queue
+            fprintf(stderr, "Could not set the listen backlog\n");
+            return EXIT_FAILURE;
+        }
+    }
 
     Thread *threads = malloc(t * sizeof(Thread)); // Allocate memory for the thread pointers
-    hashTable ht = newHT(); // Initialize a new hash table
-    queue_t *queue = queue_new(t); // Initialize a new queue with the specified number of threads
+    // The dump reports what the locks count.  Shared locks count for every process and
+    // reading them drains them, so only the first process reports them, for all.
+    if (process == 0) {
+        metrics_watch_locks(locks);
+    }
+    // Each process has its own cache, which must notice other processes' PUTs
+    file_cache_t *cache = file_cache_new(cacheBytes, shared);
+    work_queue_t *queue = work_queue_new(t); // One deque per worker thread
+
+    // The event loop never waits on a full queue: past what it holds, requests get 503.
+    if (maxInflight == 0 || maxInflight > t * WORK_QUEUE_SLOTS) {
+        maxInflight = t * WORK_QUEUE_SLOTS;
+    }
+    admission_start(maxInflight, perClient);
+    if (uring) {
+        async_io_start(queue); // without io_uring the workers keep doing their own I/O
+    }
 
     // Create worker threads
     for (int i = 0; i < t; i++) {
         threads[i] = malloc(sizeof(ThreadObj)); // Allocate memory for each thread object
         threads[i]->id = i; // Assign an ID to each thread
-        threads[i]->hashTable = &ht; // Assign the hash table to each thread
+        threads[i]->locks = locks; // Share the lock table with each thread
+        threads[i]->cache = cache; // And the file cache
         threads[i]->queue = queue; // Assign the queue to each thread
         pthread_create(&threads[i]->thread, NULL, (void *(*) (void *) ) worker_thread,
             threads[i]); // Create the worker thread
+        if (pin) {
+            pin_thread(threads[i]->thread, process * t + i); // Keep the worker on one CPU
+        }
     }
 
-    // Dispatcher loop
-    while (1) {
-        uintptr_t connfd = listener_accept(&sock); // Accept new connections
-        queue_push(
-            queue, (void *) connfd); // Push the new connection file descriptor into the queue
-    }
+    // Dispatcher loop: accepts and reads request heads without blocking, then
+    // pushes each connection with a complete head into the queue
+    event_loop_run(sock.fd, queue, cache);
 
     // Code to free allocated resources would go here (not reached in this snippet)
     free(threads);
-    freeHT(&ht);
+    lock_table_delete(&locks);
+    file_cache_delete(&cache);
+    work_queue_delete(&queue);
 
     return EXIT_SUCCESS; // Return success status
 }
 
-void request_parser(int connfd, hashTable ht) {
-
-    // Create a new connection object based on the file descriptor from the accepted connection.
-    conn_t *conn = conn_new(connfd);
+// Returns true if the connection went to the I/O thread, which then owns it
+bool request_parser(connection_t *conn, lock_table_t *locks, file_cache_t *cache) {
 
-    // Parse the connection to determine the request details and potentially generate a preliminary response (e.g., error response).
-    const Response_t *response = conn_parse(conn);
+    // The event loop already parsed the head; a malformed one left an error response.
+    const Response_t *response = conn->error;
 
     // Check if the parsing resulted in an immediate response (e.g., due to a parsing error).
     if (response != NULL) {
         // If there's an immediate response, send it back to the client.
-        conn_send_response(conn, response);
+        connection_send_response(conn, response);
     } else {
         // Output the connection details for debugging purposes.
-        debug("%s", conn_str(conn));
+        debug("%s /%s", request_get_str(conn->request), conn->uri);
         // Determine the type of HTTP request (GET, PUT, etc.).
-        const Request_t *request = conn_get_request(conn);
+        const Request_t *request = conn->request;
 
         // Handle GET requests.
         if (request == &REQUEST_GET) {
             // Extract the URI from the request.
-            char *URI = conn_get_uri(conn);
+            char *URI = conn->uri;
 
             // Initialize the response pointer to NULL.
             const Response_t *response = NULL;
 
-            // Lock the mutex to ensure thread-safe access to the hash table.
-            pthread_mutex_lock(&mutex);
-
-            // Look up the hash lock for the URI. If it doesn't exist, create a new lock and attach it to the hash table.
-            rwlock_t *hashLock = hashLockLookup(ht->head, URI);
-            if (hashLock == NULL) {
-                hashLock = rwlock_new(N_WAY, 1);
-                attach(ht, URI, hashLock);
-            }
-            // Unlock the mutex after modifying the hash table.
-            pthread_mutex_unlock(&mutex);
+            // Look up the URI's lock, creating it if no other request holds it.
+            lock_entry_t *entry = lock_table_acquire(locks, URI);
+            rwlock_t *hashLock = entry->lock;
 
             // Acquire a reader lock for the URI's hash lock.
+            uint64_t waited = metrics_now();
             reader_lock(hashLock);
+            metrics_lock_wait(0, waited);
+            uint64_t io = metrics_now();
+
+            // The parser only lets URIs of [a-zA-Z0-9.-] through, so the name is safe to open.
+
+            // Hot files are served from the content cache without open/fstat/read.
+            int fd = -1;
+            file_version_t version;
+            cache_blob_t *blob = file_cache_lookup(cache, URI);
+            if (blob == NULL) {
+                // Attempt to open the file specified by the URI for reading.
+                fd = open(URI, O_RDONLY);
+
+                // Handle errors encountered while opening the file.
+                if (fd < 0) {
+                    const char *reqID = connection_get_header(conn, "Request-Id");
+                    if (reqID == NULL)
+                        reqID = "0";
+                    // Determine the appropriate error response based on the error code.
+                    if (errno == ENOENT) {
+                        response = &RESPONSE_NOT_FOUND;
+                    } else if (errno == EACCES || errno == EISDIR) {
+                        response = &RESPONSE_FORBIDDEN;
+                    } else {
+                        response = &RESPONSE_INTERNAL_SERVER_ERROR;
+                    }
+                    audit_log("GET,/%s,%d,%s\n", URI, response_get_code(response), reqID);
+                    goto out; // Jump to the response sending section.
+                }
 
-            // Check if the URI consists only of alphanumeric characters. If not, prepare a Bad Request response.
-            if (!AlphaNumeric(URI)) {
-                response = &RESPONSE_BAD_REQUEST;
-                char *identification = conn_get_header(conn, "Request-Id");
-                // Use "0" as the default request ID if none is provided.
-                if (identification == NULL)
-                    identification = "0";
-                fprintf(stderr, "GET,/%s,400,%s\n", URI, identification);
-                goto out; // Jump to the response sending section.
-            }
+                // Retrieve file statistics.
+                struct stat fileStat;
+                fstat(fd, &fileStat);
 
-            // Attempt to open the file specified by the URI for reading.
-            int fd = open(URI, O_RDONLY);
-
-            // Handle errors encountered while opening the file.
-            if (fd < 0) {
-                char *reqID = conn_get_header(conn, "Request-Id");
-                if (reqID == NULL)
-                    reqID = "0";
-                // Determine the appropriate error response based on the error code.
-                if (errno == ENOENT) {
-                    response = &RESPONSE_NOT_FOUND;
-                } else if (errno == EACCES || errno == EISDIR) {
+                // Check if the URI points to a directory. If so, prepare a Forbidden response.
+                if (S_ISDIR(fileStat.st_mode)) {
                     response = &RESPONSE_FORBIDDEN;
-                } else {
-                    response = &RESPONSE_INTERNAL_SERVER_ERROR;
+                    const char *reqID = connection_get_header(conn, "Request-Id");
+                    if (reqID == NULL)
+                        reqID = "0";
+                    audit_log("GET,/%s,403,%s\n", URI, reqID);
+                    close(fd);
+                    goto out; // Jump to the response sending section.
                 }
-                fprintf(stderr, "GET,/%s,%d,%s\n", URI, response_get_code(response), reqID);
-                goto out; // Jump to the response sending section.
-            }
 
-            // Retrieve file statistics.
-            struct stat fileStat;
-            fstat(fd, &fileStat);
-
-            // Check if the URI points to a directory. If so, prepare a Forbidden response.
-            if (S_ISDIR(fileStat.st_mode)) {
-                response = &RESPONSE_FORBIDDEN;
-                char *reqID = conn_get_header(conn, "Request-Id");
-                if (reqID == NULL)
-                    reqID = "0";
-                fprintf(stderr, "GET,/%s,403,%s\n", URI, reqID);
-                goto out; // Jump to the response sending section.
-            }
+                // The size, inode and mtime make up the ETag and Last-Modified.
+                file_version_of(&fileStat, &version);
 
-            // Get the file size from the file statistics.
-            int fileSize = (int) fileStat.st_size;
+                // Small files are read into the cache; the rest are sent from the open fd.
+                if (S_ISREG(fileStat.st_mode) && file_cache_admits(cache, version.size)
+                    && (blob = file_cache_load(cache, URI, fd, &version)) != NULL) {
+                    close(fd);
+                    fd = -1;
+                }
+            } else {
+                version = blob->version;
+            }
 
-            // Attempt to send the file to the client.
-            response = conn_send_file(conn, fd, fileSize);
+            // Conditional and partial GETs are decided from the version alone.
+            range_set_t ranges;
+            int status = range_plan(connection_get_header(conn, "Range"),
+                connection_get_header(conn, "If-Range"),
+                connection_get_header(conn, "If-None-Match"),
+                connection_get_header(conn, "If-Modified-Since"), &version, &ranges);
+
+            // The blob or open fd pins this version: PUT renames a new file into place
+            // rather than writing this one, so the reader lock can go before sending.
+            // The line is logged here, before the send, on purpose: only under the lock
+            // is it in order with the PUTs of this URI.  It records the response the
+            // server chose; a send that fails later only shows up in the debug output.
+            const char *reqID = connection_get_header(conn, "Request-Id");
+            if (reqID == NULL)
+                reqID = "0";
+            audit_log("GET,/%s,%d,%s\n", URI, status, reqID);
+            metrics_stage(STAGE_IO, io);
+            reader_unlock(hashLock);
+            lock_table_release(locks, entry);
 
-            // If sending the file succeeds, prepare an OK response.
-            if (response == NULL) {
-                response = &RESPONSE_OK;
-                char *reqID = conn_get_header(conn, "Request-Id");
-                if (reqID == NULL)
-                    reqID = "0";
-                fprintf(stderr, "GET,/%s,200,%s\n", URI, reqID);
+            // A 304 or 416 has no body to send.
+            if (status == 304 || status == 416) {
+                if (status == 304) {
+                    connection_send_not_modified(conn, &version);
+                } else {
+                    connection_send_unsatisfiable(conn, &version);
+                }
+                cache_blob_release(&blob);
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return false;
             }
 
-            // Release the reader lock and close the file descriptor before returning.
-            reader_unlock(hashLock);
-            close(fd);
-            return;
+            // Send the file without holding the lock, or have the I/O thread send it.
+            if (blob != NULL) {
+                if (async_io_send_blob(conn, blob, &ranges)) {
+                    return true;
+                }
+                if (connection_send_data(conn, blob->data, &version, &ranges) != NULL) {
+                    debug("sending cached /%s failed after logging %d", URI, status);
+                }
+                cache_blob_release(&blob);
+            } else {
+                if (async_io_send_file(conn, fd, &version, &ranges)) {
+                    return true;
+                }
+                if (connection_send_file(conn, fd, &version, &ranges) != NULL) {
+                    debug("sending /%s failed after logging %d", URI, status);
+                }
+                close(fd);
+            }
+            return false;
 
         out:
-            // Send the prepared response to the client and release the reader lock.
-            conn_send_response(conn, response);
+            // Release the reader lock and send the prepared response to the client.
+            metrics_stage(STAGE_IO, io);
             reader_unlock(hashLock);
+            lock_table_release(locks, entry);
+            connection_send_response(conn, response);
 
         } else if (request == &REQUEST_PUT) {
             // The process for handling PUT requests is similar to GET requests,
-            // with specific differences in file handling and lock types.
+            // but the body is received before the writer lock is taken.
 
             // Extract the URI from the request.
-            char *URI = conn_get_uri(conn);
+            char *URI = conn->uri;
             // Initialize the response pointer to NULL.
             const Response_t *res = NULL;
             // Output debug information indicating a PUT request is being handled.
             debug("handling PUT request for %s", URI);
 
-            // Check if the file already exists.
-            bool existed = access(URI, F_OK) == 0;
-            debug("%s existed? %d", URI, existed);
-
-            // Lock the mutex to ensure thread-safe access to the hash table.
-            pthread_mutex_lock(&mutex);
-
-            // Look up or create a new hash lock for the URI.
-            rwlock_t *hashLock = hashLockLookup(ht->head, URI);
-            if (hashLock == NULL) {
-                hashLock = rwlock_new(N_WAY, 1);
-                attach(ht, URI, hashLock);
-            }
-            // Unlock the mutex after modifying the hash table.
-            pthread_mutex_unlock(&mutex);
-
-            // Acquire a writer lock for the URI's hash lock.
-            writer_lock(hashLock);
+            const char *reqID = connection_get_header(conn, "Request-Id");
+            if (reqID == NULL)
+                reqID = "0";
+
+            char tempName[sizeof(conn->upload_name)] = "_put_XXXXXX";
+            if (conn->upload_name[0] != '\0') {
+                // Back from the I/O thread with the body in the temp file.
+                strcpy(tempName, conn->upload_name);
+                conn->upload_name[0] = '\0';
+                res = conn->upload_error;
+            } else {
+                // A directory, or a file we may not write, cannot be replaced: refuse before
+                // reading the body.  This lock-free check is only a fast path; the refusal
+                // stands once it is checked again under the writer lock.
+                struct stat target;
+                bool found = stat(URI, &target) == 0;
+                if (found && (S_ISDIR(target.st_mode) || access(URI, W_OK) != 0)) {
+                    if (audit_put_refusal(locks, URI, 403, reqID)) {
+                        res = &RESPONSE_FORBIDDEN;
+                        goto finish; // Jump to the response sending section.
+                    }
+                    found = stat(URI, &target) == 0;
+                }
 
-            // Open or create the file specified by the URI for writing.
-            int fd = open(URI, O_CREAT | O_TRUNC | O_WRONLY, 0600);
-            // Handle file opening errors.
-            if (fd < 0) {
-                debug("Error opening %s: %d", URI, errno);
-                char *reqID = conn_get_header(conn, "Request-Id");
-                if (reqID == NULL)
-                    reqID = "0";
-
-                // Determine the appropriate error response.
-                if (errno == EACCES || errno == EISDIR || errno == ENOENT) {
-                    res = &RESPONSE_FORBIDDEN;
-                } else {
+                // Stream the body into a temp file without holding any lock, so GETs keep
+                // serving the old version during the upload.  '_' is not allowed in a URI,
+                // so no request can reach the temp file.
+                int fd = mkstemp(tempName);
+                if (fd < 0) {
+                    debug("Error creating a temp file for %s: %d", URI, errno);
                     res = &RESPONSE_INTERNAL_SERVER_ERROR;
+                    audit_put_refusal(locks, URI, 500, reqID);
+                    goto finish; // Jump to the response sending section.
+                }
+                if (found) {
+                    fchmod(fd, target.st_mode & 07777); // keep the replaced file's permissions
                 }
-                fprintf(stderr, "PUT,/%s,403,%s\n", URI, reqID);
+                // Only now is the body worth sending, if the client is waiting to hear that.
+                connection_send_continue(conn);
+                if (async_io_recv_file(conn, fd, tempName)) {
+                    return true; // a worker gets the connection back once the body is in
+                }
+                uint64_t io = metrics_now();
+                res = connection_recv_file(conn, fd);
+                close(fd);
+                metrics_stage(STAGE_IO, io);
+            }
+
+            // A failed upload leaves the old version untouched.
+            if (res != NULL) {
+                unlink(tempName);
                 goto finish; // Jump to the response sending section.
             }
 
-            // Attempt to receive and save the file from the client.
-            res = conn_recv_file(conn, fd);
+            // Look up or create the URI's lock.
+            lock_entry_t *entry = lock_table_acquire(locks, URI);
+            rwlock_t *hashLock = entry->lock;
+
+            // The writer lock is only held to swap the new version in.
+            uint64_t waited = metrics_now();
+            writer_lock(hashLock);
+            metrics_lock_wait(1, waited);
+
+            // Check if the file already exists.
+            bool existed = access(URI, F_OK) == 0;
+            debug("%s existed? %d", URI, existed);
 
-            // Determine the appropriate success response based on whether the file existed.
-            if (res == NULL) {
+            // The file may have become a directory or read-only during the upload.
+            if (put_forbidden(URI)) {
+                res = &RESPONSE_FORBIDDEN;
+                unlink(tempName);
+            } else if (rename(tempName, URI) == 0) {
+                file_cache_invalidate(cache, URI);
                 res = existed ? &RESPONSE_OK : &RESPONSE_CREATED;
-                char *reqID = conn_get_header(conn, "Request-Id");
-                if (reqID == NULL)
-                    reqID = "0";
-                fprintf(stderr, "PUT,/%s,%d,%s\n", URI, response_get_code(res), reqID);
+            } else {
+                debug("Error renaming %s to %s: %d", tempName, URI, errno);
+                res = errno == EISDIR ? &RESPONSE_FORBIDDEN : &RESPONSE_INTERNAL_SERVER_ERROR;
+                unlink(tempName);
             }
+            audit_log("PUT,/%s,%d,%s\n", URI, response_get_code(res), reqID);
 
-            // Release the writer lock and close the file descriptor.
+            // Release the writer lock.
             writer_unlock(hashLock);
-            close(fd);
+            lock_table_release(locks, entry);
 
         finish:
             // Send the response to the client.
-            conn_send_response(conn, res);
+            connection_send_response(conn, res);
         } else {
             // Handle unsupported request types.
             no_coverage(conn);
         }
     }
-
-    // Delete the connection object, freeing its resources.
-    conn_delete(&conn);
+    return false;
 }
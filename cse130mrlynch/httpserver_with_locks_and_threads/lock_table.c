@@ -0,0 +1,266 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lock_table.h"
+
+// Buckets a shard starts with; it doubles whenever it holds more
+// entries than buckets
+#define INITIAL_BUCKETS 16
+
+// Reclaimed entries a shard keeps so hot URIs do not allocate a new
+// rwlock on every request
+#define MAX_SPARES 8
+
+typedef struct {
+    pthread_mutex_t mutex;
+    lock_entry_t **buckets;
+    uint32_t num_buckets; // a power of two
+    uint32_t count;
+    lock_entry_t *spares;
+    int num_spares;
+    rwlock_stats_t retired; // counted by locks since unlinked
+} shard_t;
+
+struct lock_table {
+    PRIORITY priority;
+    uint32_t n;
+    shard_t shards[LOCK_TABLE_SHARDS];
+
+    // A shared table's locks, and an entry for each that is never freed
+    rwlock_t *stripe_locks;
+    lock_entry_t *stripes;
+};
+
+// FNV-1a
+static uint32_t hash_uri(const char *uri) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *) uri; *c != '\0'; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// The low bits pick the bucket, so the shard comes from the high bits
+static shard_t *shard_for(lock_table_t *table, uint32_t hash) {
+    return &table->shards[(hash >> 26) & (LOCK_TABLE_SHARDS - 1)];
+}
+
+static void add_stats(rwlock_stats_t *to, const rwlock_stats_t *from) {
+    to->reads += from->reads;
+    to->writes += from->writes;
+    to->read_waits += from->read_waits;
+    to->write_waits += from->write_waits;
+    to->read_wait_ns += from->read_wait_ns;
+    to->write_wait_ns += from->write_wait_ns;
+    to->handoffs += from->handoffs;
+}
+
+static lock_entry_t **allocate_buckets(uint32_t num_buckets) {
+    lock_entry_t **buckets = calloc(num_buckets, sizeof(lock_entry_t *));
+    if (buckets == NULL) {
+        fprintf(stderr, "Error allocating memory for the lock table\n");
+        exit(EXIT_FAILURE);
+    }
+    return buckets;
+}
+
+static void grow(shard_t *shard) {
+    uint32_t num_buckets = shard->num_buckets * 2;
+    lock_entry_t **buckets = allocate_buckets(num_buckets);
+
+    for (uint32_t i = 0; i < shard->num_buckets; i++) {
+        lock_entry_t *entry = shard->buckets[i];
+        while (entry != NULL) {
+            lock_entry_t *next = entry->next;
+            lock_entry_t **bucket = &buckets[entry->hash & (num_buckets - 1)];
+            entry->next = *bucket;
+            *bucket = entry;
+            entry = next;
+        }
+    }
+    free(shard->buckets);
+    shard->buckets = buckets;
+    shard->num_buckets = num_buckets;
+}
+
+static lock_entry_t *new_entry(
+    lock_table_t *table, shard_t *shard, const char *uri, uint32_t hash) {
+    lock_entry_t *entry = shard->spares;
+    if (entry != NULL) {
+        shard->spares = entry->next;
+        shard->num_spares--;
+        // What ADAPTIVE learned was about another URI
+        rwlock_configure(entry->lock, table->priority, table->n);
+    } else {
+        entry = malloc(sizeof(lock_entry_t));
+        if (entry == NULL) {
+            fprintf(stderr, "Error allocating memory for the lock table\n");
+            exit(EXIT_FAILURE);
+        }
+        entry->lock = rwlock_new(table->priority, table->n);
+    }
+    entry->uri = strdup(uri);
+    entry->hash = hash;
+    entry->refs = 0;
+    return entry;
+}
+
+static void free_entry(lock_entry_t *entry) {
+    free(entry->uri);
+    rwlock_delete(&entry->lock);
+    free(entry);
+}
+
+lock_table_t *lock_table_new(PRIORITY p, uint32_t n) {
+    lock_table_t *table = malloc(sizeof(lock_table_t));
+    if (table == NULL) {
+        fprintf(stderr, "Error allocating memory for the lock table\n");
+        exit(EXIT_FAILURE);
+    }
+    table->priority = p;
+    table->n = n;
+    table->stripe_locks = NULL;
+    table->stripes = NULL;
+    for (int i = 0; i < LOCK_TABLE_SHARDS; i++) {
+        shard_t *shard = &table->shards[i];
+        pthread_mutex_init(&shard->mutex, NULL);
+        shard->buckets = allocate_buckets(INITIAL_BUCKETS);
+        shard->num_buckets = INITIAL_BUCKETS;
+        shard->count = 0;
+        shard->spares = NULL;
+        shard->num_spares = 0;
+        shard->retired = (rwlock_stats_t) { 0 };
+    }
+    return table;
+}
+
+lock_table_t *lock_table_new_shared(PRIORITY p, uint32_t n) {
+    lock_table_t *table = lock_table_new(p, n);
+    table->stripe_locks = rwlock_new_shared(p, n, LOCK_TABLE_STRIPES);
+    table->stripes = calloc(LOCK_TABLE_STRIPES, sizeof(lock_entry_t));
+    if (table->stripes == NULL) {
+        fprintf(stderr, "Error allocating memory for the lock table\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < LOCK_TABLE_STRIPES; i++) {
+        table->stripes[i].lock = rwlock_at(table->stripe_locks, i);
+        table->stripes[i].hash = i;
+    }
+    return table;
+}
+
+void lock_table_delete(lock_table_t **table) {
+    if (table == NULL || *table == NULL) {
+        return;
+    }
+    for (int i = 0; i < LOCK_TABLE_SHARDS; i++) {
+        shard_t *shard = &(*table)->shards[i];
+        for (uint32_t b = 0; b < shard->num_buckets; b++) {
+            lock_entry_t *entry = shard->buckets[b];
+            while (entry != NULL) {
+                lock_entry_t *next = entry->next;
+                free_entry(entry);
+                entry = next;
+            }
+        }
+        while (shard->spares != NULL) {
+            lock_entry_t *next = shard->spares->next;
+            free_entry(shard->spares);
+            shard->spares = next;
+        }
+        free(shard->buckets);
+        pthread_mutex_destroy(&shard->mutex);
+    }
+    free((*table)->stripes);
+    rwlock_delete_shared(&(*table)->stripe_locks, LOCK_TABLE_STRIPES);
+    free(*table);
+    *table = NULL;
+}
+
+lock_entry_t *lock_table_acquire(lock_table_t *table, const char *uri) {
+    uint32_t hash = hash_uri(uri);
+    if (table->stripes != NULL) {
+        return &table->stripes[hash & (LOCK_TABLE_STRIPES - 1)];
+    }
+    shard_t *shard = shard_for(table, hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    lock_entry_t **bucket = &shard->buckets[hash & (shard->num_buckets - 1)];
+    lock_entry_t *entry = *bucket;
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->uri, uri) != 0)) {
+        entry = entry->next;
+    }
+
+    if (entry == NULL) {
+        entry = new_entry(table, shard, uri, hash);
+        entry->next = *bucket;
+        *bucket = entry;
+        if (++shard->count > shard->num_buckets) {
+            grow(shard);
+        }
+    }
+    entry->refs++;
+    pthread_mutex_unlock(&shard->mutex);
+    return entry;
+}
+
+void lock_table_release(lock_table_t *table, lock_entry_t *entry) {
+    if (table->stripes != NULL) {
+        return; // stripes live as long as the table
+    }
+    shard_t *shard = shard_for(table, entry->hash);
+
+    pthread_mutex_lock(&shard->mutex);
+    if (--entry->refs > 0) {
+        pthread_mutex_unlock(&shard->mutex);
+        return;
+    }
+
+    // Last holder: unlink the entry; its lock is idle, so it can be reused
+    lock_entry_t **link = &shard->buckets[entry->hash & (shard->num_buckets - 1)];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    shard->count--;
+    rwlock_drain_stats(entry->lock, &shard->retired);
+
+    free(entry->uri);
+    entry->uri = NULL;
+    if (shard->num_spares < MAX_SPARES) {
+        entry->next = shard->spares;
+        shard->spares = entry;
+        shard->num_spares++;
+        entry = NULL;
+    }
+    pthread_mutex_unlock(&shard->mutex);
+
+    if (entry != NULL) {
+        rwlock_delete(&entry->lock);
+        free(entry);
+    }
+}
+
+void lock_table_drain_stats(lock_table_t *table, rwlock_stats_t *stats) {
+    if (table->stripes != NULL) {
+        for (uint32_t i = 0; i < LOCK_TABLE_STRIPES; i++) {
+            rwlock_drain_stats(table->stripes[i].lock, stats);
+        }
+        return;
+    }
+    for (int i = 0; i < LOCK_TABLE_SHARDS; i++) {
+        shard_t *shard = &table->shards[i];
+        pthread_mutex_lock(&shard->mutex);
+        for (uint32_t b = 0; b < shard->num_buckets; b++) {
+            for (lock_entry_t *entry = shard->buckets[b]; entry != NULL; entry = entry->next) {
+                rwlock_drain_stats(entry->lock, stats);
+            }
+        }
+        add_stats(stats, &shard->retired);
+        shard->retired = (rwlock_stats_t) { 0 };
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
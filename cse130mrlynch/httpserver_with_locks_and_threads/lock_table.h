@@ -0,0 +1,76 @@
+/**
+ * @File lock_table.h
+ *
+ * Maps each URI being served to the reader/writer lock that orders its
+ * GETs and PUTs.  The table is split into shards, each a hash table with
+ * its own mutex, so lookups of different URIs rarely contend.  Entries
+ * are reference counted and reclaimed as soon as no request holds them,
+ * so the table only ever holds the URIs currently in use.  Every lock
+ * gets the priority and n the table was made with, and counts its own
+ * waits and handoffs; the table keeps the counts of reclaimed locks.
+ *
+ * A table made with lock_table_new_shared instead stripes URIs over a
+ * fixed set of locks by hash, in memory that processes forked afterwards
+ * share.  URIs that share a stripe wait for each other, which costs some
+ * concurrency but cannot deadlock, as a request holds one URI lock at a
+ * time.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "rwlock.h"
+
+// Number of independently locked shards; a power of two
+#define LOCK_TABLE_SHARDS 64
+
+// Locks in a shared table; a power of two
+#define LOCK_TABLE_STRIPES 4096
+
+/** @struct lock_entry_t
+ *
+ *  @brief One URI's lock.  Only lock is meant for callers; the rest is
+ *         owned by the table.
+ */
+typedef struct lock_entry {
+    rwlock_t *lock;
+
+    char *uri;
+    uint32_t hash;
+    int refs; // requests holding this entry, guarded by the shard mutex
+    struct lock_entry *next; // bucket chain, or the shard's spare list
+} lock_entry_t;
+
+typedef struct lock_table lock_table_t;
+
+/** @brief Allocates an empty table whose locks get priority p and n.
+ */
+lock_table_t *lock_table_new(PRIORITY p, uint32_t n);
+
+/** @brief Allocates a table of LOCK_TABLE_STRIPES locks with priority p
+ *         and n, shared with the processes forked after it.
+ */
+lock_table_t *lock_table_new_shared(PRIORITY p, uint32_t n);
+
+/** @brief Frees the table and every entry still in it.  Sets *table to
+ *         NULL.
+ */
+void lock_table_delete(lock_table_t **table);
+
+/** @brief Looks up uri's entry, creating it if no request holds it, and
+ *         takes a reference.  Lock entry->lock afterwards, not before.
+ *
+ *  @return The entry; pass it to lock_table_release when done.
+ */
+lock_entry_t *lock_table_acquire(lock_table_t *table, const char *uri);
+
+/** @brief Drops a reference taken by lock_table_acquire.  The caller
+ *         must have unlocked entry->lock already.
+ */
+void lock_table_release(lock_table_t *table, lock_entry_t *entry);
+
+/** @brief Adds up what every lock has counted since the last call into
+ *         *stats, reclaimed locks included.
+ */
+void lock_table_drain_stats(lock_table_t *table, rwlock_stats_t *stats);
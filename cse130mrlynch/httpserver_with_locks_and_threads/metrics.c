@@ -0,0 +1,280 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+// Latency buckets: bucket 0 is under 1 us, bucket i under 2^i us, and the
+// last one takes everything slower (about 17 s and up)
+#define HIST_BUCKETS 25
+
+#define NUM_METHODS 3 // GET, PUT, anything else
+
+static const uint16_t status_codes[]
+    = { 200, 201, 206, 304, 400, 403, 404, 416, 500, 501, 503, 505 };
+#define NUM_STATUSES (sizeof(status_codes) / sizeof(status_codes[0]) + 1) // last: other
+
+static const char *const method_names[NUM_METHODS] = { "GET", "PUT", "other" };
+static const char *const stage_names[NUM_STAGES] = { "queue", "lock", "io", "send", "total" };
+static const char *const lock_modes[2] = { "read", "write" };
+
+typedef struct {
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sum_ns;
+    atomic_uint_fast64_t buckets[HIST_BUCKETS];
+} histogram_t;
+
+// One thread's counters.  Only that thread writes them, so updates are a
+// relaxed load and store; the dump thread reads them while they change.
+typedef struct metrics_block {
+    atomic_uint_fast64_t responses[NUM_METHODS][NUM_STATUSES];
+    atomic_uint_fast64_t lock_acquired[2];
+    atomic_uint_fast64_t lock_contended[2];
+    atomic_uint_fast64_t steals;
+    histogram_t stages[NUM_STAGES];
+    struct metrics_block *next;
+} metrics_block_t;
+
+static pthread_mutex_t blocks_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Atomic(metrics_block_t *) blocks = NULL;
+static _Thread_local metrics_block_t *my_block = NULL;
+
+// Shared gauges, touched once per connection or queue hand-off
+static atomic_int_fast64_t connections = 0;
+static atomic_int_fast64_t queued = 0;
+
+// The URI locks, and what they have counted so far; only the dump thread
+// touches the totals
+static _Atomic(lock_table_t *) watched_locks = NULL;
+static rwlock_stats_t lock_totals;
+
+static metrics_block_t *get_block(void) {
+    if (my_block != NULL) {
+        return my_block;
+    }
+    metrics_block_t *block = calloc(1, sizeof(metrics_block_t));
+    if (block == NULL) {
+        fprintf(stderr, "Error allocating memory for metrics\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_mutex_lock(&blocks_lock);
+    block->next = atomic_load(&blocks);
+    atomic_store_explicit(&blocks, block, memory_order_release);
+    pthread_mutex_unlock(&blocks_lock);
+    return my_block = block;
+}
+
+static inline void bump(atomic_uint_fast64_t *counter, uint64_t by) {
+    atomic_store_explicit(
+        counter, atomic_load_explicit(counter, memory_order_relaxed) + by, memory_order_relaxed);
+}
+
+static inline uint64_t peek(atomic_uint_fast64_t *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void metrics_watch_locks(lock_table_t *table) {
+    atomic_store(&watched_locks, table);
+}
+
+uint64_t metrics_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static void record(histogram_t *histogram, uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    if (bucket >= HIST_BUCKETS) {
+        bucket = HIST_BUCKETS - 1;
+    }
+    bump(&histogram->count, 1);
+    bump(&histogram->sum_ns, ns);
+    bump(&histogram->buckets[bucket], 1);
+}
+
+void metrics_stage(STAGE stage, uint64_t start) {
+    uint64_t now = metrics_now();
+    record(&get_block()->stages[stage], now > start ? now - start : 0);
+}
+
+void metrics_lock_wait(int writer, uint64_t start) {
+    uint64_t now = metrics_now();
+    uint64_t waited = now > start ? now - start : 0;
+    metrics_block_t *block = get_block();
+    writer = writer ? 1 : 0;
+    bump(&block->lock_acquired[writer], 1);
+    if (waited > LOCK_CONTENDED_NS) {
+        bump(&block->lock_contended[writer], 1);
+    }
+    record(&block->stages[STAGE_LOCK], waited);
+}
+
+void metrics_response(const Request_t *request, uint16_t code) {
+    int method = request == &REQUEST_GET ? 0 : request == &REQUEST_PUT ? 1 : 2;
+    size_t status = 0;
+    while (status < NUM_STATUSES - 1 && status_codes[status] != code) {
+        status++;
+    }
+    bump(&get_block()->responses[method][status], 1);
+}
+
+void metrics_connection_opened(void) {
+    atomic_fetch_add_explicit(&connections, 1, memory_order_relaxed);
+}
+
+void metrics_connection_closed(void) {
+    atomic_fetch_sub_explicit(&connections, 1, memory_order_relaxed);
+}
+
+void metrics_queue_pushed(void) {
+    atomic_fetch_add_explicit(&queued, 1, memory_order_relaxed);
+}
+
+void metrics_queue_popped(void) {
+    atomic_fetch_sub_explicit(&queued, 1, memory_order_relaxed);
+}
+
+void metrics_work_stolen(void) {
+    bump(&get_block()->steals, 1);
+}
+
+// Adds up every thread's block; the totals are a snapshot, not atomic
+// across counters
+static void sum_blocks(metrics_block_t *total) {
+    metrics_block_t *block = atomic_load_explicit(&blocks, memory_order_acquire);
+    for (; block != NULL; block = block->next) {
+        for (int m = 0; m < NUM_METHODS; m++) {
+            for (size_t s = 0; s < NUM_STATUSES; s++) {
+                bump(&total->responses[m][s], peek(&block->responses[m][s]));
+            }
+        }
+        for (int w = 0; w < 2; w++) {
+            bump(&total->lock_acquired[w], peek(&block->lock_acquired[w]));
+            bump(&total->lock_contended[w], peek(&block->lock_contended[w]));
+        }
+        bump(&total->steals, peek(&block->steals));
+        for (int st = 0; st < NUM_STAGES; st++) {
+            histogram_t *from = &block->stages[st];
+            histogram_t *to = &total->stages[st];
+            bump(&to->count, peek(&from->count));
+            bump(&to->sum_ns, peek(&from->sum_ns));
+            for (int b = 0; b < HIST_BUCKETS; b++) {
+                bump(&to->buckets[b], peek(&from->buckets[b]));
+            }
+        }
+    }
+}
+
+// Prometheus text format, histogram buckets cumulative
+static void dump(FILE *out) {
+    metrics_block_t total = { 0 };
+    sum_blocks(&total);
+
+    fprintf(out, "connections_active %lld\n", (long long) atomic_load(&connections));
+    fprintf(out, "queue_depth %lld\n", (long long) atomic_load(&queued));
+
+    for (int m = 0; m < NUM_METHODS; m++) {
+        for (size_t s = 0; s < NUM_STATUSES; s++) {
+            uint64_t count = peek(&total.responses[m][s]);
+            if (count == 0) {
+                continue;
+            }
+            if (s < NUM_STATUSES - 1) {
+                fprintf(out, "responses_total{method=\"%s\",status=\"%u\"} %llu\n",
+                    method_names[m], status_codes[s], (unsigned long long) count);
+            } else {
+                fprintf(out, "responses_total{method=\"%s\",status=\"other\"} %llu\n",
+                    method_names[m], (unsigned long long) count);
+            }
+        }
+    }
+
+    for (int w = 0; w < 2; w++) {
+        fprintf(out, "lock_acquisitions_total{mode=\"%s\"} %llu\n", lock_modes[w],
+            (unsigned long long) peek(&total.lock_acquired[w]));
+        fprintf(out, "lock_contended_total{mode=\"%s\"} %llu\n", lock_modes[w],
+            (unsigned long long) peek(&total.lock_contended[w]));
+    }
+
+    lock_table_t *locks = atomic_load(&watched_locks);
+    if (locks != NULL) {
+        lock_table_drain_stats(locks, &lock_totals);
+        fprintf(out, "lock_waits_total{mode=\"read\"} %llu\n",
+            (unsigned long long) lock_totals.read_waits);
+        fprintf(out, "lock_waits_total{mode=\"write\"} %llu\n",
+            (unsigned long long) lock_totals.write_waits);
+        fprintf(out, "lock_wait_us_total{mode=\"read\"} %llu\n",
+            (unsigned long long) (lock_totals.read_wait_ns / 1000));
+        fprintf(out, "lock_wait_us_total{mode=\"write\"} %llu\n",
+            (unsigned long long) (lock_totals.write_wait_ns / 1000));
+        fprintf(out, "lock_handoffs_total %llu\n", (unsigned long long) lock_totals.handoffs);
+    }
+
+    fprintf(out, "work_steals_total %llu\n", (unsigned long long) peek(&total.steals));
+
+    for (int st = 0; st < NUM_STAGES; st++) {
+        histogram_t *histogram = &total.stages[st];
+        uint64_t count = peek(&histogram->count);
+        uint64_t below = 0;
+        for (int b = 0; b < HIST_BUCKETS - 1 && below < count; b++) {
+            below += peek(&histogram->buckets[b]);
+            fprintf(out, "latency_us_bucket{stage=\"%s\",le=\"%llu\"} %llu\n", stage_names[st],
+                1ULL << b, (unsigned long long) below);
+        }
+        fprintf(out, "latency_us_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", stage_names[st],
+            (unsigned long long) count);
+        fprintf(out, "latency_us_sum{stage=\"%s\"} %llu\n", stage_names[st],
+            (unsigned long long) (peek(&histogram->sum_ns) / 1000));
+        fprintf(out, "latency_us_count{stage=\"%s\"} %llu\n", stage_names[st],
+            (unsigned long long) count);
+    }
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+static void *dump_thread(void *arg) {
+    sigset_t *set = arg;
+    int sig;
+    while (sigwait(set, &sig) == 0) {
+        // Formatted first and written at once, so that the dumps of server
+        // processes sharing stdout do not interleave
+        char *text = NULL;
+        size_t size = 0;
+        FILE *out = open_memstream(&text, &size);
+        if (out == NULL) {
+            dump(stdout);
+            continue;
+        }
+        dump(out);
+        fclose(out);
+        for (size_t done = 0; done < size;) {
+            ssize_t bytes = write(STDOUT_FILENO, text + done, size - done);
+            if (bytes <= 0) {
+                break;
+            }
+            done += bytes;
+        }
+        free(text);
+    }
+    return NULL;
+}
+
+void metrics_start(void) {
+    static sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    pthread_t dumper;
+    if (pthread_create(&dumper, NULL, dump_thread, &set) != 0) {
+        fprintf(stderr, "Could not start the metrics thread\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_detach(dumper);
+}
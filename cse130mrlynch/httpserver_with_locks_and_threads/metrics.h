@@ -0,0 +1,70 @@
+/**
+ * @File metrics.h
+ *
+ * Request counters and latency histograms.  Each thread records into
+ * its own block, so recording is a few uncontended stores; SIGUSR1
+ * makes a dedicated thread add the blocks up and print them to stdout
+ * (stderr carries the audit log), e.g. kill -USR1 $(pidof httpserver).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "connection.h"
+#include "lock_table.h"
+
+/** @brief Where a request spends its time.
+ */
+typedef enum {
+    STAGE_QUEUE, // head parsed until a worker picks the connection up
+    STAGE_LOCK, // waiting for the URI's reader or writer lock
+    STAGE_IO, // file work: cache lookup, open, read, or receiving a PUT body
+    STAGE_SEND, // writing the response
+    STAGE_TOTAL, // start of the worker's handling to the end of the response
+    NUM_STAGES
+} STAGE;
+
+// A lock wait longer than this counts as contended
+#define LOCK_CONTENDED_NS 10000
+
+/** @brief Blocks SIGUSR1 and starts the thread that answers it.  Call
+ *         from main before any other thread exists, so that every thread
+ *         inherits the blocked signal.
+ */
+void metrics_start(void);
+
+/** @brief Has the dump include the waits and handoffs counted by the
+ *         locks in table.  The dump drains those counts, so when several
+ *         processes share table, call this in one of them only.
+ */
+void metrics_watch_locks(lock_table_t *table);
+
+/** @brief Nanoseconds on the monotonic clock.
+ */
+uint64_t metrics_now(void);
+
+/** @brief Records that stage took the time since start.
+ */
+void metrics_stage(STAGE stage, uint64_t start);
+
+/** @brief Records a lock wait that began at start, for a writer or a
+ *         reader.
+ */
+void metrics_lock_wait(int writer, uint64_t start);
+
+/** @brief Counts a response with status code to a request (NULL if the
+ *         head could not be parsed).
+ */
+void metrics_response(const Request_t *request, uint16_t code);
+
+/** @brief Connections open, and connections waiting in the worker queue.
+ */
+void metrics_connection_opened(void);
+void metrics_connection_closed(void);
+void metrics_queue_pushed(void);
+void metrics_queue_popped(void);
+
+/** @brief Counts a connection a worker took from another worker's deque.
+ */
+void metrics_work_stolen(void);
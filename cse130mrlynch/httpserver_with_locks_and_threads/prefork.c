@@ -0,0 +1,119 @@
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "prefork.h"
+
+// Stops every child still running and reaps them all
+static void stop_children(pid_t *children, int processes, int sig) {
+    for (int i = 0; i < processes; i++) {
+        if (children[i] > 0) {
+            kill(children[i], sig);
+        }
+    }
+    for (int i = 0; i < processes; i++) {
+        if (children[i] > 0) {
+            waitpid(children[i], NULL, 0);
+            children[i] = 0;
+        }
+    }
+}
+
+// The parent's life: forward signals until one ends the server
+static void supervise(pid_t *children, int processes, const sigset_t *signals) {
+    while (1) {
+        int sig;
+        if (sigwait(signals, &sig) != 0) {
+            continue;
+        }
+        if (sig == SIGUSR1) {
+            for (int i = 0; i < processes; i++) {
+                kill(children[i], SIGUSR1);
+            }
+            continue;
+        }
+        if (sig == SIGINT || sig == SIGTERM) {
+            stop_children(children, processes, sig);
+            exit(EXIT_SUCCESS);
+        }
+
+        // SIGCHLD: a server process is gone, and its connections with it
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (int i = 0; i < processes; i++) {
+                if (children[i] == pid) {
+                    children[i] = 0;
+                    fprintf(stderr, "Server process %d exited\n", i);
+                    stop_children(children, processes, SIGTERM);
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+}
+
+int prefork_spawn(int processes) {
+    // Block the signals the parent waits for before forking, so none is
+    // lost in between; each child puts its mask back
+    sigset_t signals, old;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &signals, &old);
+
+    pid_t *children = calloc(processes, sizeof(pid_t));
+    if (children == NULL) {
+        fprintf(stderr, "Error allocating memory for the server processes\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < processes; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            free(children);
+            prctl(PR_SET_PDEATHSIG, SIGTERM); // do not outlive the parent
+            sigprocmask(SIG_SETMASK, &old, NULL);
+            return i;
+        }
+        if (pid < 0) {
+            fprintf(stderr, "Could not start server process %d\n", i);
+            stop_children(children, processes, SIGTERM);
+            exit(EXIT_FAILURE);
+        }
+        children[i] = pid;
+    }
+    supervise(children, processes, &signals);
+    return -1; // not reached
+}
+
+int prefork_listen(int port, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t) port);
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, backlog) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,25 @@
+/**
+ * @File prefork.h
+ *
+ * Running the server as several processes that accept on the same port.
+ * Each process binds its own listening socket with SO_REUSEPORT, so the
+ * kernel spreads new connections across them and no one accept loop
+ * sees every client.  The parent only starts the processes and watches
+ * over them.
+ */
+
+#pragma once
+
+/** @brief Forks processes server processes.  Call before any thread
+ *         exists.  Returns only in the children, each with its index;
+ *         the parent stays to pass SIGINT, SIGTERM and SIGUSR1 on to
+ *         them, and once any of them exits, stops the rest and exits.
+ */
+int prefork_spawn(int processes);
+
+/** @brief Opens a socket listening on port with a queue of backlog,
+ *         bound with SO_REUSEPORT so the other processes bind it too.
+ *
+ *  @return The socket, or -1 if it could not be bound.
+ */
+int prefork_listen(int port, int backlog);
@@ -1,59 +0,0 @@
-/**
- * @File queue.h
- *
- * The header file that you need to implement for assignment 3.
- *
- * @author Andrew Quinn
- */
-
-#pragma once
-
-#include <stdbool.h>
-#include <stdint.h>
-#include <sys/types.h>
-
-/** @struct queue_t
- *
- *  @brief This typedef renames the struct queue.  Your `c` file
- *  should define the variables that you need for your queue.
- */
-typedef struct queue queue_t;
-
-/** @brief Dynamically allocates and initializes a new queue with a
- *         maximum size, size
- *
- *  @param size the maximum size of the queue
- *
- *  @return a pointer to a new queue_t
- */
-queue_t *queue_new(int size);
-
-/** @brief Delete your queue and free all of its memory.
- *
- *  @param q the queue to be deleted.  Note, you should assign the
- *  passed in pointer to NULL when returning (i.e., you should set
- *  *q = NULL after deallocation).
- */
-void queue_delete(queue_t **q);
-
-/** @brief push an element onto a queue
- *
- *  @param q the queue to push an element into.
- *
- *  @param elem th element to add to the queue
- *
- *  @return A bool indicating success or failure.  Note, the function
- *          should succeed unless the q parameter is NULL.
- */
-bool queue_push(queue_t *q, void *elem);
-
-/** @brief pop an element from a queue.
- *
- *  @param q the queue to pop an element from.
- *
- *  @param elem a place to assign the poped element.
- *
- *  @return A bool indicating success or failure.  Note, the function
- *          should succeed unless the q parameter is NULL.
- */
-bool queue_pop(queue_t *q, void **elem);
@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "range.h"
+
+#define HTTP_DATE_FORMAT "%a, %d %b %Y %H:%M:%S GMT"
+
+void file_version_of(const struct stat *st, file_version_t *version) {
+    version->size = (uint64_t) st->st_size;
+    version->inode = (uint64_t) st->st_ino;
+    version->mtime_sec = (int64_t) st->st_mtim.tv_sec;
+    version->mtime_nsec = (int64_t) st->st_mtim.tv_nsec;
+}
+
+int format_etag(const file_version_t *version, char *etag, size_t size) {
+    return snprintf(etag, size, "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "\"", version->inode,
+        version->size,
+        (uint64_t) version->mtime_sec * 1000000000 + (uint64_t) version->mtime_nsec);
+}
+
+int format_http_date(const file_version_t *version, char *date, size_t size) {
+    time_t seconds = (time_t) version->mtime_sec;
+    struct tm tm;
+    gmtime_r(&seconds, &tm);
+    return (int) strftime(date, size, HTTP_DATE_FORMAT, &tm);
+}
+
+static bool parse_http_date(const char *value, int64_t *seconds) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(value, HTTP_DATE_FORMAT, &tm);
+    if (end == NULL || *end != '\0') {
+        return false;
+    }
+    *seconds = (int64_t) timegm(&tm);
+    return true;
+}
+
+// Whether etag is in list, a comma-separated If-None-Match value; weak
+// comparison, so a W/ prefix does not matter
+static bool etag_listed(const char *list, const char *etag) {
+    size_t etag_len = strlen(etag);
+    const char *p = list;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        const char *token = p;
+        while (*p != '\0' && *p != ',') {
+            p++;
+        }
+        const char *end = p;
+        while (end > token && (end[-1] == ' ' || end[-1] == '\t')) {
+            end--;
+        }
+        if (end - token == 1 && *token == '*') {
+            return true;
+        }
+        if (end - token > 2 && strncmp(token, "W/", 2) == 0) {
+            token += 2;
+        }
+        if ((size_t) (end - token) == etag_len && strncmp(token, etag, etag_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// If-Range holds an ETag (compared strongly) or a date that must be the
+// file's Last-Modified exactly
+static bool if_range_holds(const char *value, const char *etag, const file_version_t *version) {
+    if (*value == '"') {
+        return strcmp(value, etag) == 0;
+    }
+    int64_t seconds;
+    return parse_http_date(value, &seconds) && seconds == version->mtime_sec;
+}
+
+// Reads a decimal number at *p; false if there is none or it overflows
+static bool parse_number(const char **p, uint64_t *number) {
+    const char *s = *p;
+    uint64_t n = 0;
+    while (*s >= '0' && *s <= '9') {
+        if (n > (UINT64_MAX - (*s - '0')) / 10) {
+            return false;
+        }
+        n = n * 10 + (*s - '0');
+        s++;
+    }
+    if (s == *p) {
+        return false;
+    }
+    *p = s;
+    *number = n;
+    return true;
+}
+
+// Sorts ranges by where they start and merges the ones that overlap or touch,
+// so no byte is sent twice however the specs repeat one another
+static void merge_ranges(range_set_t *ranges) {
+    for (int i = 1; i < ranges->count; i++) {
+        byte_range_t range = ranges->ranges[i];
+        int j = i;
+        while (j > 0 && ranges->ranges[j - 1].first > range.first) {
+            ranges->ranges[j] = ranges->ranges[j - 1];
+            j--;
+        }
+        ranges->ranges[j] = range;
+    }
+    int merged = 0;
+    for (int i = 1; i < ranges->count; i++) {
+        byte_range_t *last = &ranges->ranges[merged];
+        const byte_range_t *range = &ranges->ranges[i];
+        if (range->first <= last->first + last->length) {
+            uint64_t end = range->first + range->length;
+            if (end > last->first + last->length) {
+                last->length = end - last->first;
+            }
+        } else {
+            ranges->ranges[++merged] = *range;
+        }
+    }
+    if (ranges->count > 0) {
+        ranges->count = merged + 1;
+    }
+}
+
+// Fills ranges from a Range value, sorted and merged.  Returns 200 to ignore
+// the header (not bytes, malformed, or too many ranges) or when the ranges
+// cover the whole file, 206, or 416 if none is satisfiable.
+static int parse_ranges(const char *value, uint64_t size, range_set_t *ranges) {
+    if (strncmp(value, "bytes=", 6) != 0) {
+        return 200;
+    }
+    const char *p = value + 6;
+    int specs = 0;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == ',') {
+            p++;
+            continue; // empty list element
+        }
+        if (++specs > MAX_RANGES) {
+            ranges->count = 0;
+            return 200;
+        }
+
+        uint64_t first, last;
+        bool satisfiable;
+        if (*p == '-') {
+            // The last n bytes
+            p++;
+            uint64_t n;
+            if (!parse_number(&p, &n)) {
+                ranges->count = 0;
+                return 200;
+            }
+            satisfiable = n > 0 && size > 0;
+            first = n >= size ? 0 : size - n;
+            last = size - 1;
+        } else {
+            if (!parse_number(&p, &first) || *p++ != '-') {
+                ranges->count = 0;
+                return 200;
+            }
+            last = UINT64_MAX;
+            if (*p >= '0' && *p <= '9' && (!parse_number(&p, &last) || last < first)) {
+                ranges->count = 0;
+                return 200;
+            }
+            satisfiable = first < size;
+            if (last >= size) {
+                last = size - 1;
+            }
+        }
+        if (satisfiable) {
+            ranges->ranges[ranges->count].first = first;
+            ranges->ranges[ranges->count].length = last - first + 1;
+            ranges->count++;
+        }
+
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            ranges->count = 0;
+            return 200;
+        }
+    }
+    if (specs == 0) {
+        return 200;
+    }
+    if (ranges->count == 0) {
+        return 416;
+    }
+
+    // Ranges that add up to the whole file are cheaper sent as one 200
+    merge_ranges(ranges);
+    if (ranges->count == 1 && ranges->ranges[0].first == 0 && ranges->ranges[0].length == size) {
+        ranges->count = 0;
+        return 200;
+    }
+    return 206;
+}
+
+int range_plan(const char *range, const char *if_range, const char *if_none_match,
+    const char *if_modified_since, const file_version_t *version, range_set_t *ranges) {
+    ranges->count = 0;
+    char etag[ETAG_MAX];
+    format_etag(version, etag, sizeof(etag));
+
+    // If-None-Match, when sent, overrides If-Modified-Since
+    int64_t since;
+    if (if_none_match != NULL) {
+        if (etag_listed(if_none_match, etag)) {
+            return 304;
+        }
+    } else if (if_modified_since != NULL && parse_http_date(if_modified_since, &since)
+               && version->mtime_sec <= since) {
+        return 304;
+    }
+
+    // A Range conditioned on an older version gets the whole file
+    if (range == NULL || (if_range != NULL && !if_range_holds(if_range, etag, version))) {
+        return 200;
+    }
+    return parse_ranges(range, version->size, ranges);
+}
+
+byte_range_t range_piece(const file_version_t *version, const range_set_t *ranges, int i) {
+    if (ranges->count == 0) {
+        byte_range_t whole = { 0, version->size };
+        return whole;
+    }
+    return ranges->ranges[i];
+}
+
+int range_pieces(const range_set_t *ranges) {
+    return ranges->count == 0 ? 1 : ranges->count;
+}
+
+// The multipart boundary; ETags are made of hex digits and dashes, which
+// cannot clash with the framing
+static int format_boundary(const file_version_t *version, char *boundary, size_t size) {
+    char etag[ETAG_MAX];
+    int length = format_etag(version, etag, sizeof(etag));
+    return snprintf(boundary, size, "range-%.*s", length - 2, etag + 1);
+}
+
+int range_header_fields(
+    const file_version_t *version, const range_set_t *ranges, char *fields, size_t size) {
+    if (ranges->count == 0) {
+        fields[0] = '\0';
+        return 0;
+    }
+    if (ranges->count == 1) {
+        const byte_range_t *range = &ranges->ranges[0];
+        return snprintf(fields, size,
+            "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64 "\r\n", range->first,
+            range->first + range->length - 1, version->size);
+    }
+    char boundary[ETAG_MAX + 8];
+    format_boundary(version, boundary, sizeof(boundary));
+    return snprintf(fields, size, "Content-Type: multipart/byteranges; boundary=%s\r\n", boundary);
+}
+
+int range_part_header(
+    const file_version_t *version, const range_set_t *ranges, int i, char *part, size_t size) {
+    if (ranges->count < 2) {
+        part[0] = '\0';
+        return 0;
+    }
+    char boundary[ETAG_MAX + 8];
+    format_boundary(version, boundary, sizeof(boundary));
+    const byte_range_t *range = &ranges->ranges[i];
+    return snprintf(part, size,
+        "\r\n--%s\r\nContent-Type: application/octet-stream\r\n"
+        "Content-Range: bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64 "\r\n\r\n",
+        boundary, range->first, range->first + range->length - 1, version->size);
+}
+
+int range_closing(
+    const file_version_t *version, const range_set_t *ranges, char *end, size_t size) {
+    if (ranges->count < 2) {
+        end[0] = '\0';
+        return 0;
+    }
+    char boundary[ETAG_MAX + 8];
+    format_boundary(version, boundary, sizeof(boundary));
+    return snprintf(end, size, "\r\n--%s--\r\n", boundary);
+}
+
+uint64_t range_body_length(const file_version_t *version, const range_set_t *ranges) {
+    char part[RANGE_PART_MAX];
+    uint64_t length = 0;
+    for (int i = 0; i < range_pieces(ranges); i++) {
+        length += range_part_header(version, ranges, i, part, sizeof(part));
+        length += range_piece(version, ranges, i).length;
+    }
+    return length + range_closing(version, ranges, part, sizeof(part));
+}
@@ -0,0 +1,107 @@
+/**
+ * @File range.h
+ *
+ * Partial and conditional GETs: byte ranges asked for with Range (sent
+ * back as 206, several at once as multipart/byteranges), and the
+ * validators a client returns in If-None-Match, If-Modified-Since or
+ * If-Range.  A file's ETag is made of its inode, size and modification
+ * time, so a PUT, which renames a new file into place, always changes it.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+// Ranges answered in one response; a request for more gets the whole file
+#define MAX_RANGES 16
+
+// Room for a quoted ETag, an HTTP date, and one multipart part header
+#define ETAG_MAX        56
+#define HTTP_DATE_MAX   32
+#define RANGE_PART_MAX  256
+
+/** @struct file_version_t
+ *  @brief What tells one version of a file from another.
+ */
+typedef struct {
+    uint64_t size;
+    uint64_t inode;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+} file_version_t;
+
+/** @struct byte_range_t
+ *  @brief length bytes starting at first, all within the file.
+ */
+typedef struct {
+    uint64_t first;
+    uint64_t length;
+} byte_range_t;
+
+/** @struct range_set_t
+ *  @brief The ranges to send, sorted, with overlapping and adjacent ones
+ *         merged; none means the whole file with a 200.
+ */
+typedef struct {
+    int count;
+    byte_range_t ranges[MAX_RANGES];
+} range_set_t;
+
+/** @brief The version of the file described by st.
+ */
+void file_version_of(const struct stat *st, file_version_t *version);
+
+/** @brief Formats version's quoted ETag into etag (ETAG_MAX bytes).
+ */
+int format_etag(const file_version_t *version, char *etag, size_t size);
+
+/** @brief Formats version's modification time as an HTTP date into date
+ *         (HTTP_DATE_MAX bytes).
+ */
+int format_http_date(const file_version_t *version, char *date, size_t size);
+
+/** @brief Decides how to answer a GET of version, given the values of its
+ *         Range, If-Range, If-None-Match and If-Modified-Since headers
+ *         (NULL when absent).  Headers that do not parse are ignored.
+ *
+ *  @return 200 with ranges->count 0 (also when the ranges cover the
+ *          whole file), 206 with the ranges filled in, 304, or 416 when
+ *          no range asked for lies within the file.
+ */
+int range_plan(const char *range, const char *if_range, const char *if_none_match,
+    const char *if_modified_since, const file_version_t *version, range_set_t *ranges);
+
+/** @brief The piece of the file sent as part i of ranges; the whole file
+ *         for a 200.
+ */
+byte_range_t range_piece(const file_version_t *version, const range_set_t *ranges, int i);
+
+/** @brief The number of pieces in a response: 1 for a 200.
+ */
+int range_pieces(const range_set_t *ranges);
+
+/** @brief Formats the header fields that describe the ranges into
+ *         fields (RANGE_PART_MAX bytes): Content-Range for one range, the
+ *         multipart Content-Type for several, nothing for a 200.
+ */
+int range_header_fields(
+    const file_version_t *version, const range_set_t *ranges, char *fields, size_t size);
+
+/** @brief Formats the multipart header before part i into part
+ *         (RANGE_PART_MAX bytes); empty unless there are several ranges.
+ */
+int range_part_header(
+    const file_version_t *version, const range_set_t *ranges, int i, char *part, size_t size);
+
+/** @brief Formats the line that ends a multipart body into end
+ *         (RANGE_PART_MAX bytes); empty unless there are several ranges.
+ */
+int range_closing(
+    const file_version_t *version, const range_set_t *ranges, char *end, size_t size);
+
+/** @brief Bytes in the body of the response: the pieces, plus the
+ *         multipart framing if there are several.
+ */
+uint64_t range_body_length(const file_version_t *version, const range_set_t *ranges);
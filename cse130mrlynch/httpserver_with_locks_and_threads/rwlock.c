@@ -0,0 +1,247 @@
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "rwlock.h"
+
+// ADAPTIVE halves its read and write history once it holds this many, so
+// the batch follows the recent mix rather than the lock's whole life
+#define HISTORY_WINDOW 256
+
+typedef enum { HELD_READ, HELD_WRITE } MODE;
+
+struct rwlock {
+    pthread_mutex_t mutex;
+    pthread_cond_t read, write;
+    PRIORITY priority;
+    uint32_t n;
+
+    int readers; // holding the lock
+    bool writer;
+    int waiting_readers, waiting_writers;
+    uint32_t batch; // readers let in since the last writer let go
+    MODE last; // how the lock was last taken, to count handoffs
+
+    uint32_t recent_reads, recent_writes; // ADAPTIVE's history
+    rwlock_stats_t stats;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+// Readers let in between writers while a writer waits
+static uint32_t batch_limit(const rwlock_t *rw) {
+    uint32_t limit = rw->n > 0 ? rw->n : 1;
+    if (rw->priority == ADAPTIVE) {
+        uint32_t ratio = rw->recent_reads / (rw->recent_writes + 1);
+        if (ratio > RWLOCK_MAX_BATCH) {
+            ratio = RWLOCK_MAX_BATCH;
+        }
+        if (ratio > limit) {
+            limit = ratio;
+        }
+    }
+    return limit;
+}
+
+static bool reader_may_enter(const rwlock_t *rw) {
+    if (rw->writer) {
+        return false;
+    }
+    switch (rw->priority) {
+    case READERS: return true;
+    case WRITERS: return rw->waiting_writers == 0;
+    default: return rw->waiting_writers == 0 || rw->batch < batch_limit(rw);
+    }
+}
+
+static bool writer_may_enter(const rwlock_t *rw) {
+    if (rw->writer || rw->readers > 0) {
+        return false;
+    }
+    switch (rw->priority) {
+    case READERS: return rw->waiting_readers == 0;
+    case WRITERS: return true;
+    default: return rw->waiting_readers == 0 || rw->batch >= batch_limit(rw);
+    }
+}
+
+// Counts an acquisition in mode; called with the mutex held
+static void note_acquired(rwlock_t *rw, MODE mode) {
+    if (mode == HELD_WRITE || rw->last == HELD_WRITE) {
+        rw->stats.handoffs++;
+    }
+    rw->last = mode;
+    if (mode == HELD_READ) {
+        rw->stats.reads++;
+        rw->recent_reads++;
+    } else {
+        rw->stats.writes++;
+        rw->recent_writes++;
+    }
+    if (rw->recent_reads + rw->recent_writes >= HISTORY_WINDOW) {
+        rw->recent_reads /= 2;
+        rw->recent_writes /= 2;
+    }
+}
+
+// Sets up zeroed memory as a lock, shared between processes if pshared
+static void init_lock(rwlock_t *rw, PRIORITY p, uint32_t n, int pshared) {
+    pthread_mutexattr_t mutex_attr;
+    pthread_condattr_t cond_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_condattr_init(&cond_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, pshared);
+    pthread_condattr_setpshared(&cond_attr, pshared);
+    pthread_mutex_init(&rw->mutex, &mutex_attr);
+    pthread_cond_init(&rw->read, &cond_attr);
+    pthread_cond_init(&rw->write, &cond_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+    pthread_condattr_destroy(&cond_attr);
+    rw->priority = p;
+    rw->n = n;
+    rw->last = HELD_READ;
+}
+
+rwlock_t *rwlock_new(PRIORITY p, uint32_t n) {
+    rwlock_t *rw = calloc(1, sizeof(rwlock_t));
+    if (rw == NULL) {
+        fprintf(stderr, "Error allocating memory for a rwlock\n");
+        exit(EXIT_FAILURE);
+    }
+    init_lock(rw, p, n, PTHREAD_PROCESS_PRIVATE);
+    return rw;
+}
+
+rwlock_t *rwlock_new_shared(PRIORITY p, uint32_t n, size_t count) {
+    // Anonymous shared memory comes zeroed and stays shared across fork
+    rwlock_t *locks = mmap(NULL, count * sizeof(rwlock_t), PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (locks == MAP_FAILED) {
+        fprintf(stderr, "Error mapping shared memory for %zu rwlocks\n", count);
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < count; i++) {
+        init_lock(&locks[i], p, n, PTHREAD_PROCESS_SHARED);
+    }
+    return locks;
+}
+
+rwlock_t *rwlock_at(rwlock_t *locks, size_t i) {
+    return &locks[i];
+}
+
+void rwlock_delete_shared(rwlock_t **locks, size_t count) {
+    if (locks == NULL || *locks == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        pthread_mutex_destroy(&(*locks)[i].mutex);
+        pthread_cond_destroy(&(*locks)[i].read);
+        pthread_cond_destroy(&(*locks)[i].write);
+    }
+    munmap(*locks, count * sizeof(rwlock_t));
+    *locks = NULL;
+}
+
+void rwlock_delete(rwlock_t **rw) {
+    if (rw == NULL || *rw == NULL) {
+        return;
+    }
+    pthread_mutex_destroy(&(*rw)->mutex);
+    pthread_cond_destroy(&(*rw)->read);
+    pthread_cond_destroy(&(*rw)->write);
+    free(*rw);
+    *rw = NULL;
+}
+
+void rwlock_configure(rwlock_t *rw, PRIORITY p, uint32_t n) {
+    pthread_mutex_lock(&rw->mutex);
+    rw->priority = p;
+    rw->n = n;
+    rw->recent_reads = 0;
+    rw->recent_writes = 0;
+    // Anyone waiting rechecks under the new rules
+    pthread_cond_broadcast(&rw->read);
+    pthread_cond_broadcast(&rw->write);
+    pthread_mutex_unlock(&rw->mutex);
+}
+
+void rwlock_drain_stats(rwlock_t *rw, rwlock_stats_t *stats) {
+    pthread_mutex_lock(&rw->mutex);
+    stats->reads += rw->stats.reads;
+    stats->writes += rw->stats.writes;
+    stats->read_waits += rw->stats.read_waits;
+    stats->write_waits += rw->stats.write_waits;
+    stats->read_wait_ns += rw->stats.read_wait_ns;
+    stats->write_wait_ns += rw->stats.write_wait_ns;
+    stats->handoffs += rw->stats.handoffs;
+    rw->stats = (rwlock_stats_t) { 0 };
+    pthread_mutex_unlock(&rw->mutex);
+}
+
+void reader_lock(rwlock_t *rw) {
+    pthread_mutex_lock(&rw->mutex);
+    if (!reader_may_enter(rw)) {
+        // The clock is only read when the lock is contended
+        uint64_t start = now_ns();
+        rw->waiting_readers++;
+        do {
+            pthread_cond_wait(&rw->read, &rw->mutex);
+        } while (!reader_may_enter(rw));
+        rw->waiting_readers--;
+        rw->stats.read_waits++;
+        rw->stats.read_wait_ns += now_ns() - start;
+    }
+    rw->readers++;
+    rw->batch++;
+    note_acquired(rw, HELD_READ);
+    pthread_mutex_unlock(&rw->mutex);
+}
+
+void reader_unlock(rwlock_t *rw) {
+    pthread_mutex_lock(&rw->mutex);
+    rw->readers--;
+    if (rw->readers == 0 && rw->waiting_writers > 0) {
+        pthread_cond_signal(&rw->write);
+    }
+    pthread_mutex_unlock(&rw->mutex);
+}
+
+void writer_lock(rwlock_t *rw) {
+    pthread_mutex_lock(&rw->mutex);
+    if (!writer_may_enter(rw)) {
+        uint64_t start = now_ns();
+        rw->waiting_writers++;
+        do {
+            pthread_cond_wait(&rw->write, &rw->mutex);
+        } while (!writer_may_enter(rw));
+        rw->waiting_writers--;
+        rw->stats.write_waits++;
+        rw->stats.write_wait_ns += now_ns() - start;
+    }
+    rw->writer = true;
+    note_acquired(rw, HELD_WRITE);
+    pthread_mutex_unlock(&rw->mutex);
+}
+
+void writer_unlock(rwlock_t *rw) {
+    pthread_mutex_lock(&rw->mutex);
+    rw->writer = false;
+    rw->batch = 0;
+    // Waiting readers get the next turn unless writers come first; the
+    // ones past the batch limit go back to waiting, and the last reader
+    // out wakes the next writer
+    if (rw->waiting_readers > 0 && (rw->priority != WRITERS || rw->waiting_writers == 0)) {
+        pthread_cond_broadcast(&rw->read);
+    } else if (rw->waiting_writers > 0) {
+        pthread_cond_signal(&rw->write);
+    }
+    pthread_mutex_unlock(&rw->mutex);
+}
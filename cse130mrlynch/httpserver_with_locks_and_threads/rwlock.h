@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 /** @struct rwlock_t
@@ -18,7 +19,28 @@
  */
 typedef struct rwlock rwlock_t;
 
-typedef enum { READERS, WRITERS, N_WAY } PRIORITY;
+// ADAPTIVE is N_WAY with n as a floor: each lock raises its batch to the
+// ratio of reads to writes it has seen lately, up to RWLOCK_MAX_BATCH
+typedef enum { READERS, WRITERS, N_WAY, ADAPTIVE } PRIORITY;
+
+// Most readers an ADAPTIVE lock lets in between two writers
+#define RWLOCK_MAX_BATCH 64
+
+/** @struct rwlock_stats_t
+ *
+ *  @brief What a lock has counted.  A wait is an acquisition that had to
+ *         block; a handoff starts a new turn: a writer taking the lock, or
+ *         readers taking it after a writer.
+ */
+typedef struct {
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t read_waits;
+    uint64_t write_waits;
+    uint64_t read_wait_ns;
+    uint64_t write_wait_ns;
+    uint64_t handoffs;
+} rwlock_stats_t;
 
 /** @brief Dynamically allocates and initializes a new rwlock with
  *         priority p, and, if using N_WAY priority, n.
@@ -31,6 +53,22 @@ typedef enum { READERS, WRITERS, N_WAY } PRIORITY;
  */
 rwlock_t *rwlock_new(PRIORITY p, uint32_t n);
 
+/** @brief Allocates count rwlocks, all with priority p and n, in memory
+ *         that processes forked afterwards share, so the locks order
+ *         those processes' threads too.
+ *
+ *  @return The first lock; rwlock_at finds the others.
+ */
+rwlock_t *rwlock_new_shared(PRIORITY p, uint32_t n, size_t count);
+
+/** @brief The i-th of the locks rwlock_new_shared allocated.
+ */
+rwlock_t *rwlock_at(rwlock_t *locks, size_t i);
+
+/** @brief Frees what rwlock_new_shared allocated.  Sets *locks to NULL.
+ */
+void rwlock_delete_shared(rwlock_t **locks, size_t count);
+
 /** @brief Delete your rwlock and free all of its memory.
  *
  *  @param rw the rwlock to be deleted.  Note, you should assign the
@@ -39,6 +77,15 @@ rwlock_t *rwlock_new(PRIORITY p, uint32_t n);
  */
 void rwlock_delete(rwlock_t **rw);
 
+/** @brief Changes rw's priority and n, and forgets the reads and writes
+ *         ADAPTIVE has seen.  Meant for a lock nobody holds.
+ */
+void rwlock_configure(rwlock_t *rw, PRIORITY p, uint32_t n);
+
+/** @brief Adds what rw has counted to *stats and starts its counts over.
+ */
+void rwlock_drain_stats(rwlock_t *rw, rwlock_stats_t *stats);
+
 /** @brief acquire rw for reading
  */
 void reader_lock(rwlock_t *rw);
@@ -0,0 +1,80 @@
+/**
+ * @File uring.h
+ *
+ * A minimal io_uring ring driven through the raw system calls, for
+ * machines without liburing.  A ring belongs to one thread: nothing here
+ * is safe to share.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/** @struct uring_t
+ *
+ *  @brief The mapped submission and completion queues of one ring.
+ */
+typedef struct {
+    int fd;
+
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned unsubmitted; // queued since the last io_uring_enter
+
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} uring_t;
+
+/** @brief Sets up a ring with sq_entries submission slots and room for
+ *         cq_entries completions.
+ *
+ *  @return 0, or a negative errno if io_uring is missing, disabled, or
+ *          lacks one of the operations in ops (num_ops of them).
+ */
+int uring_init(uring_t *ring, unsigned sq_entries, unsigned cq_entries, const uint8_t *ops,
+    int num_ops);
+
+/** @brief Unmaps and closes the ring.
+ */
+void uring_exit(uring_t *ring);
+
+/** @brief A zeroed submission slot for op on fd tagged with user_data,
+ *         to fill in before the next call.  Submits what is queued first
+ *         if the ring is full.
+ */
+struct io_uring_sqe *uring_prep(uring_t *ring, uint8_t op, int fd, uint64_t user_data);
+
+/** @brief Makes room for count submissions, so that the next count calls
+ *         to uring_prep do not submit in between, splitting a linked chain.
+ */
+void uring_reserve(uring_t *ring, unsigned count);
+
+/** @brief Submits everything queued and waits for at least wait
+ *         completions.
+ *
+ *  @return 0, or a negative errno.
+ */
+int uring_submit(uring_t *ring, unsigned wait);
+
+/** @brief The oldest unhandled completion, or NULL if there is none.
+ *         Call uring_seen once done with it.
+ */
+struct io_uring_cqe *uring_peek(uring_t *ring);
+
+/** @brief Hands the completion from uring_peek back to the kernel.
+ */
+void uring_seen(uring_t *ring);
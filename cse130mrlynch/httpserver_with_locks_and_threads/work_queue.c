@@ -0,0 +1,239 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "work_queue.h"
+#include "metrics.h"
+
+// The lanes of a deque, in the order they are served
+enum { LANE_URGENT, LANE_NORMAL, NUM_LANES };
+
+// A ring of items, oldest first.  count only changes under the deque's
+// mutex but is read without it to decide where to look.
+typedef struct {
+    void *items[WORK_QUEUE_SLOTS];
+    uint32_t head;
+    atomic_uint count;
+} lane_t;
+
+// One worker's deque.  sleeping is set by the owner and cleared by
+// whoever wakes it.
+typedef struct {
+    _Alignas(64) pthread_mutex_t mutex;
+    pthread_cond_t wake; // the owner was handed work while asleep
+    pthread_cond_t not_full; // pushes wait here for room in a lane
+    lane_t lanes[NUM_LANES];
+    atomic_bool sleeping;
+} deque_t;
+
+struct work_queue {
+    int workers;
+    atomic_int next; // where pushes start looking, to spread the work
+    deque_t *deques;
+};
+
+work_queue_t *work_queue_new(int workers) {
+    work_queue_t *queue = malloc(sizeof(work_queue_t));
+    deque_t *deques = aligned_alloc(_Alignof(deque_t), workers * sizeof(deque_t));
+    if (queue == NULL || deques == NULL) {
+        fprintf(stderr, "Error allocating memory for the work queue\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(deques, 0, workers * sizeof(deque_t));
+    for (int i = 0; i < workers; i++) {
+        pthread_mutex_init(&deques[i].mutex, NULL);
+        pthread_cond_init(&deques[i].wake, NULL);
+        pthread_cond_init(&deques[i].not_full, NULL);
+        for (int lane = 0; lane < NUM_LANES; lane++) {
+            atomic_init(&deques[i].lanes[lane].count, 0);
+        }
+        atomic_init(&deques[i].sleeping, false);
+    }
+    queue->workers = workers;
+    atomic_init(&queue->next, 0);
+    queue->deques = deques;
+    return queue;
+}
+
+void work_queue_delete(work_queue_t **queue) {
+    if (queue == NULL || *queue == NULL) {
+        return;
+    }
+    for (int i = 0; i < (*queue)->workers; i++) {
+        deque_t *deque = &(*queue)->deques[i];
+        pthread_mutex_destroy(&deque->mutex);
+        pthread_cond_destroy(&deque->wake);
+        pthread_cond_destroy(&deque->not_full);
+    }
+    free((*queue)->deques);
+    free(*queue);
+    *queue = NULL;
+}
+
+// Items waiting in both lanes
+static unsigned queued(deque_t *deque) {
+    return atomic_load(&deque->lanes[LANE_URGENT].count)
+           + atomic_load(&deque->lanes[LANE_NORMAL].count);
+}
+
+// Removes the oldest item of a lane.  Thieves take the oldest as well:
+// its owner is busy, and that item has waited longest.
+static void *take(deque_t *deque, int lane) {
+    lane_t *ring = &deque->lanes[lane];
+    if (atomic_load(&ring->count) == 0) {
+        return NULL; // a hint only; checked again under the lock
+    }
+    pthread_mutex_lock(&deque->mutex);
+    void *item = NULL;
+    unsigned count = atomic_load(&ring->count);
+    if (count > 0) {
+        item = ring->items[ring->head];
+        ring->head = (ring->head + 1) % WORK_QUEUE_SLOTS;
+        atomic_store(&ring->count, count - 1);
+        if (count == WORK_QUEUE_SLOTS) {
+            pthread_cond_broadcast(&deque->not_full); // the lanes share it
+        }
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return item;
+}
+
+static void *steal(work_queue_t *queue, int worker, int lane) {
+    for (int i = 1; i < queue->workers; i++) {
+        void *item = take(&queue->deques[(worker + i) % queue->workers], lane);
+        if (item != NULL) {
+            metrics_work_stolen();
+            return item;
+        }
+    }
+    return NULL;
+}
+
+// The next item for worker: urgent items anywhere come before normal
+// ones, and within a lane its own deque comes first
+static void *find_work(work_queue_t *queue, int worker) {
+    for (int lane = 0; lane < NUM_LANES; lane++) {
+        void *item = take(&queue->deques[worker], lane);
+        if (item == NULL) {
+            item = steal(queue, worker, lane);
+        }
+        if (item != NULL) {
+            return item;
+        }
+    }
+    return NULL;
+}
+
+// Wakes deque's owner if it sleeps; returns whether it did
+static bool wake(deque_t *deque) {
+    if (!atomic_load(&deque->sleeping)) {
+        return false;
+    }
+    pthread_mutex_lock(&deque->mutex);
+    bool asleep = atomic_exchange(&deque->sleeping, false);
+    if (asleep) {
+        pthread_cond_signal(&deque->wake);
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return asleep;
+}
+
+// Wakes one sleeping worker other than busy, to steal work waiting on it
+static void wake_thief(work_queue_t *queue, int busy) {
+    for (int i = 1; i < queue->workers; i++) {
+        if (wake(&queue->deques[(busy + i) % queue->workers])) {
+            return;
+        }
+    }
+}
+
+static void push(work_queue_t *queue, void *item, int lane) {
+    int workers = queue->workers;
+    int start = atomic_load_explicit(&queue->next, memory_order_relaxed);
+
+    // A sleeping worker if there is one, otherwise the shortest deque
+    int target = -1;
+    for (int i = 0; i < workers && target < 0; i++) {
+        int j = (start + i) % workers;
+        if (atomic_load(&queue->deques[j].sleeping)) {
+            target = j;
+        }
+    }
+    if (target < 0) {
+        target = start;
+        for (int i = 1; i < workers; i++) {
+            int j = (start + i) % workers;
+            if (queued(&queue->deques[j]) < queued(&queue->deques[target])) {
+                target = j;
+            }
+        }
+    }
+    atomic_store_explicit(&queue->next, (target + 1) % workers, memory_order_relaxed);
+
+    // Admission control keeps fewer items in flight than there are slots,
+    // so this only waits if it was set higher than that
+    deque_t *deque = &queue->deques[target];
+    lane_t *ring = &deque->lanes[lane];
+    pthread_mutex_lock(&deque->mutex);
+    while (atomic_load(&ring->count) == WORK_QUEUE_SLOTS) {
+        pthread_cond_wait(&deque->not_full, &deque->mutex);
+    }
+    unsigned count = atomic_load(&ring->count);
+    ring->items[(ring->head + count) % WORK_QUEUE_SLOTS] = item;
+    atomic_store(&ring->count, count + 1);
+    bool asleep = atomic_exchange(&deque->sleeping, false);
+    if (asleep) {
+        pthread_cond_signal(&deque->wake);
+    }
+    pthread_mutex_unlock(&deque->mutex);
+
+    // Pairs with the second look in work_queue_pop: a worker that started
+    // to sleep either sees this item or is seen sleeping here
+    if (!asleep) {
+        wake_thief(queue, target);
+    }
+}
+
+void work_queue_push(work_queue_t *queue, void *item) {
+    push(queue, item, LANE_NORMAL);
+}
+
+void work_queue_push_urgent(work_queue_t *queue, void *item) {
+    push(queue, item, LANE_URGENT);
+}
+
+void *work_queue_pop(work_queue_t *queue, int worker) {
+    deque_t *own = &queue->deques[worker];
+    while (1) {
+        void *item = find_work(queue, worker);
+        if (item != NULL) {
+            if (queued(own) > 0) {
+                wake_thief(queue, worker); // more waiting than this worker can start now
+            }
+            return item;
+        }
+
+        // Announce the nap, then look once more before taking it
+        atomic_store(&own->sleeping, true);
+        if ((item = find_work(queue, worker)) != NULL || queued(own) > 0) {
+            atomic_store(&own->sleeping, false);
+            if (item != NULL) {
+                // A push may have counted on this worker meanwhile
+                if (queued(own) > 0) {
+                    wake_thief(queue, worker);
+                }
+                return item;
+            }
+            continue;
+        }
+        pthread_mutex_lock(&own->mutex);
+        while (atomic_load(&own->sleeping) && queued(own) == 0) {
+            pthread_cond_wait(&own->wake, &own->mutex);
+        }
+        atomic_store(&own->sleeping, false);
+        pthread_mutex_unlock(&own->mutex);
+    }
+}
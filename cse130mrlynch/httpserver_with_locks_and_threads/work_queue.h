@@ -0,0 +1,44 @@
+/**
+ * @File work_queue.h
+ *
+ * The hand-off from the event loop to the workers, replacing the helper
+ * library's single queue_t.  Every worker has its own deque with its own
+ * lock, so workers taking work do not contend with each other.  New
+ * work goes to a sleeping worker when there is one, and a worker whose
+ * deque runs dry steals from the others before it sleeps.  Work that is
+ * quick to serve can jump ahead in an urgent lane of its own.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+// Items each lane of a worker's deque holds before a push has to wait
+#define WORK_QUEUE_SLOTS 256
+
+typedef struct work_queue work_queue_t;
+
+/** @brief Allocates deques for workers workers, numbered from 0.
+ */
+work_queue_t *work_queue_new(int workers);
+
+/** @brief Frees the queue; items still in it are not freed.  Sets *queue
+ *         to NULL.
+ */
+void work_queue_delete(work_queue_t **queue);
+
+/** @brief Hands item to a worker.  Blocks only if the chosen worker's
+ *         deque is full.  Safe to call from any thread.
+ */
+void work_queue_push(work_queue_t *queue, void *item);
+
+/** @brief Like work_queue_push, for an item that is quick to serve:
+ *         it goes ahead of every item pushed with work_queue_push.
+ */
+void work_queue_push_urgent(work_queue_t *queue, void *item);
+
+/** @brief The oldest urgent item, or failing that the oldest other item,
+ *         from worker's own deque or stolen from another worker's;
+ *         sleeps until there is one.
+ */
+void *work_queue_pop(work_queue_t *queue, int worker);
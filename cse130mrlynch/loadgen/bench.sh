@@ -0,0 +1,42 @@
+#!/bin/sh
+# Runs the same workloads against both servers and prints what loadgen
+# reports for each.  Each server runs in its own scratch directory.
+#
+#   ./bench.sh [port] [seconds]
+
+PORT=${1:-8090}
+SECONDS_EACH=${2:-5}
+HERE=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(dirname "$HERE")
+
+make -C "$HERE" >/dev/null || exit 1
+make -C "$ROOT/httpserver" >/dev/null || exit 1
+make -C "$ROOT/httpserver_with_locks_and_threads" >/dev/null || exit 1
+
+# name, server binary and its arguments
+run_server() {
+    name=$1
+    shift
+    dir=$(mktemp -d)
+    (cd "$dir" && exec "$@" "$PORT" >/dev/null 2>&1) &
+    pid=$!
+    sleep 0.5
+
+    echo "== $name"
+    for workload in "-t 1" "-t 16" "-t 16 -k" "-t 16 -k -z 1.1 -f 1000" "-t 16 -k -p 50"; do
+        echo "-- $workload"
+        # shellcheck disable=SC2086
+        "$HERE/loadgen" $workload -d "$SECONDS_EACH" "$PORT"
+    done
+    echo "-- torn content check"
+    "$HERE/loadgen" -t 16 -k -C -d "$SECONDS_EACH" "$PORT"
+
+    kill "$pid"
+    wait "$pid" 2>/dev/null
+    rm -rf "$dir"
+    PORT=$((PORT + 1))
+}
+
+run_server httpserver "$ROOT/httpserver/httpserver"
+run_server httpserver_with_locks_and_threads \
+    "$ROOT/httpserver_with_locks_and_threads/httpserver" -t 16
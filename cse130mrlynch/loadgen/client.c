@@ -0,0 +1,218 @@
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "client.h"
+
+// Longest request head; URIs are at most 63 characters
+#define HEAD_SIZE 256
+
+bool client_resolve(const char *host, int port, struct sockaddr_in *addr) {
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *found = NULL;
+    if (getaddrinfo(host, NULL, &hints, &found) != 0 || found == NULL) {
+        return false;
+    }
+    memcpy(addr, found->ai_addr, sizeof(*addr));
+    addr->sin_port = htons((uint16_t) port);
+    freeaddrinfo(found);
+    return true;
+}
+
+void client_init(client_t *client, const struct sockaddr_in *addr, bool keep_alive) {
+    client->addr = *addr;
+    client->keep_alive = keep_alive;
+    client->fd = -1;
+    client->request_id = 0;
+    client->len = 0;
+}
+
+void client_close(client_t *client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    client->fd = -1;
+    client->len = 0;
+}
+
+static bool client_connect(client_t *client) {
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0) {
+        return false;
+    }
+    // Requests are written whole, so there is nothing for Nagle to merge
+    int one = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(client->fd, (struct sockaddr *) &client->addr, sizeof(client->addr)) < 0) {
+        client_close(client);
+        return false;
+    }
+    return true;
+}
+
+// Sends every byte of the count iovecs, which it uses up
+static bool send_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = count };
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return false;
+        }
+        while (count > 0 && (size_t) sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *) iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+// Reads more after what is in buf; false at end of stream or on error
+static bool fill(client_t *client) {
+    while (1) {
+        ssize_t bytes
+            = read(client->fd, client->buf + client->len, CLIENT_BUFFER_SIZE - client->len);
+        if (bytes > 0) {
+            client->len += bytes;
+            return true;
+        }
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+// The value of field in a NUL-terminated response head, or NULL
+static const char *find_field(const char *head, const char *field) {
+    size_t n = strlen(field);
+    for (const char *line = strstr(head, "\r\n"); line != NULL; line = strstr(line + 2, "\r\n")) {
+        if (strncasecmp(line + 2, field, n) == 0 && line[2 + n] == ':') {
+            const char *value = line + 3 + n;
+            while (*value == ' ') {
+                value++;
+            }
+            return value;
+        }
+    }
+    return NULL;
+}
+
+// Reads one response.  Returns its status, 0 if it was cut off, or -1 if
+// the server closed the connection without sending any of it.
+static int read_response(client_t *client, char *body, size_t body_size, uint64_t *length) {
+    char *end;
+    while ((end = memmem(client->buf, client->len, "\r\n\r\n", 4)) == NULL) {
+        if (client->len == CLIENT_BUFFER_SIZE || !fill(client)) {
+            bool silent = client->len == 0;
+            client_close(client);
+            return silent ? -1 : 0;
+        }
+    }
+    size_t head_len = end + 4 - client->buf;
+    end[2] = '\0'; // the head is dropped below, so it can be cut in place
+
+    int status = 0;
+    if (sscanf(client->buf, "HTTP/1.%*d %d", &status) != 1) {
+        client_close(client);
+        return 0;
+    }
+    const char *content_length = find_field(client->buf, "Content-Length");
+    const char *connection = find_field(client->buf, "Connection");
+    bool until_close = content_length == NULL;
+    bool close_after = until_close || !client->keep_alive
+                       || (connection != NULL && strncasecmp(connection, "close", 5) == 0);
+    uint64_t remaining = until_close ? UINT64_MAX : strtoull(content_length, NULL, 10);
+
+    // Body bytes that arrived with the head come first
+    client->len -= head_len;
+    memmove(client->buf, client->buf + head_len, client->len);
+    uint64_t got = 0;
+    while (got < remaining) {
+        if (client->len == 0 && !fill(client)) {
+            break;
+        }
+        size_t take = client->len < remaining - got ? client->len : (size_t) (remaining - got);
+        if (body != NULL && got < body_size) {
+            memcpy(body + got, client->buf, take < body_size - got ? take : body_size - got);
+        }
+        got += take;
+        client->len -= take;
+        memmove(client->buf, client->buf + take, client->len);
+    }
+    *length = got;
+
+    if (!until_close && got < remaining) {
+        client_close(client);
+        return 0;
+    }
+    if (close_after) {
+        client_close(client);
+    }
+    return status;
+}
+
+// Sends a request made of count iovecs and reads the response
+static int exchange(client_t *client, const struct iovec *request, int count, char *body,
+    size_t body_size, uint64_t *length) {
+    *length = 0;
+    // A kept connection may have been closed by the server while idle: retry once on a new one
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool reused = client->fd >= 0;
+        if (!reused && !client_connect(client)) {
+            return 0;
+        }
+        struct iovec iov[2];
+        memcpy(iov, request, count * sizeof(struct iovec));
+        if (!send_all(client->fd, iov, count)) {
+            client_close(client);
+            if (reused) {
+                continue;
+            }
+            return 0;
+        }
+        int status = read_response(client, body, body_size, length);
+        if (status < 0 && reused) {
+            continue;
+        }
+        return status < 0 ? 0 : status;
+    }
+    return 0;
+}
+
+int client_get(client_t *client, const char *uri, char *body, size_t body_size, uint64_t *length) {
+    char head[HEAD_SIZE];
+    int head_len = snprintf(head, sizeof(head), "GET /%s HTTP/1.1\r\nRequest-Id: %llu\r\n%s\r\n",
+        uri, (unsigned long long) ++client->request_id,
+        client->keep_alive ? "" : "Connection: close\r\n");
+    struct iovec iov[1] = { { .iov_base = head, .iov_len = head_len } };
+    return exchange(client, iov, 1, body, body_size, length);
+}
+
+int client_put(client_t *client, const char *uri, const char *body, size_t length) {
+    char head[HEAD_SIZE];
+    int head_len = snprintf(head, sizeof(head),
+        "PUT /%s HTTP/1.1\r\nContent-Length: %zu\r\nRequest-Id: %llu\r\n%s\r\n", uri, length,
+        (unsigned long long) ++client->request_id,
+        client->keep_alive ? "" : "Connection: close\r\n");
+    struct iovec iov[2] = { { .iov_base = head, .iov_len = head_len },
+        { .iov_base = (void *) body, .iov_len = length } };
+    uint64_t reply_length;
+    return exchange(client, iov, 2, NULL, 0, &reply_length);
+}
@@ -0,0 +1,60 @@
+/**
+ * @File client.h
+ *
+ * A blocking HTTP/1.1 client connection for the load generator.  It sends
+ * one request at a time and reads the whole response before the next, so
+ * the time a call takes is the latency of that request.  The connection
+ * stays open between requests when keep-alive is on and the server
+ * agrees, and is reopened when the server has closed it meanwhile.
+ */
+
+#pragma once
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Room for a response head, and for reading bodies that are thrown away
+#define CLIENT_BUFFER_SIZE 16384
+
+/** @struct client_t
+ *  @brief One connection to the server under test.
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    bool keep_alive; // send requests on one connection rather than one each
+    int fd; // -1 when not connected
+    uint64_t request_id; // sent as Request-Id, counting from 1
+
+    char buf[CLIENT_BUFFER_SIZE];
+    size_t len; // bytes in buf
+} client_t;
+
+/** @brief Looks up host (a name or IPv4 address) and port.
+ *
+ *  @return false if host does not resolve.
+ */
+bool client_resolve(const char *host, int port, struct sockaddr_in *addr);
+
+/** @brief Sets up a client for addr without connecting yet.
+ */
+void client_init(client_t *client, const struct sockaddr_in *addr, bool keep_alive);
+
+/** @brief Closes the connection if it is open.
+ */
+void client_close(client_t *client);
+
+/** @brief GETs uri.  Up to body_size bytes of the body are kept in body
+ *         if it is not NULL; the rest is read and dropped.
+ *
+ *  @return The status code, or 0 if the request could not be sent or
+ *          the response was cut off.  *length is set to the body length.
+ */
+int client_get(client_t *client, const char *uri, char *body, size_t body_size, uint64_t *length);
+
+/** @brief PUTs length bytes of body to uri.
+ *
+ *  @return The status code, or 0 as for client_get.
+ */
+int client_put(client_t *client, const char *uri, const char *body, size_t length);
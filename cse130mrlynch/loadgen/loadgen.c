@@ -0,0 +1,310 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "client.h"
+#include "workload.h"
+
+// Status codes are counted in an array indexed by code; index 0 counts
+// requests that got no response at all
+#define MAX_STATUS 600
+
+// Files are named lg-0, lg-1, ...; file 0 is the hottest
+#define URI_FORMAT "lg-%d"
+
+/** @struct config_t
+ *  @brief The workload, as given on the command line.
+ */
+typedef struct {
+    struct sockaddr_in addr;
+    int threads;
+    uint64_t requests; // in all; 0 when running for seconds instead
+    double seconds;
+    bool keep_alive;
+    double put_percent;
+    int files;
+    double zipf_s;
+    size_t size; // PUT body bytes; the smallest version in the check
+    bool check; // hammer one file and look for torn GETs
+    zipf_t zipf;
+} config_t;
+
+/** @struct worker_t
+ *  @brief One thread of clients and what it measured.
+ */
+typedef struct {
+    pthread_t thread;
+    int id;
+    const config_t *config;
+    uint64_t quota; // requests to send when the count is fixed
+    uint64_t deadline; // when to stop otherwise
+
+    client_t client;
+    rng_t rng;
+    char *body; // the PUT body, or the GET body being checked
+    size_t body_size;
+
+    uint64_t *latencies; // nanoseconds, one per request
+    size_t count;
+    size_t capacity;
+    uint64_t statuses[MAX_STATUS];
+    uint64_t checked; // GET bodies checked for tearing
+    uint64_t torn;
+} worker_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void *checked_malloc(size_t size) {
+    void *p = malloc(size);
+    if (p == NULL) {
+        fprintf(stderr, "Error allocating memory\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void record(worker_t *worker, uint64_t latency) {
+    if (worker->count == worker->capacity) {
+        worker->capacity = worker->capacity == 0 ? 4096 : worker->capacity * 2;
+        worker->latencies = realloc(worker->latencies, worker->capacity * sizeof(uint64_t));
+        if (worker->latencies == NULL) {
+            fprintf(stderr, "Error allocating memory for latencies\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    worker->latencies[worker->count++] = latency;
+}
+
+static void *worker_run(void *arg) {
+    worker_t *worker = arg;
+    const config_t *config = worker->config;
+    uint64_t seq = 1; // version 0 of every file is the one written before the run
+
+    for (uint64_t i = 0; config->requests > 0 ? i < worker->quota : now_ns() < worker->deadline;
+         i++) {
+        bool put = rng_uniform(&worker->rng) * 100 < config->put_percent;
+        char uri[32];
+        snprintf(uri, sizeof(uri), URI_FORMAT, zipf_pick(&config->zipf, &worker->rng));
+
+        int status;
+        if (put) {
+            size_t size = config->check ? stamp_size(config->size, seq) : config->size;
+            stamp_fill(worker->body, size, worker->id, seq++);
+            uint64_t start = now_ns();
+            status = client_put(&worker->client, uri, worker->body, size);
+            record(worker, now_ns() - start);
+        } else {
+            uint64_t length;
+            uint64_t start = now_ns();
+            status = client_get(&worker->client, uri, config->check ? worker->body : NULL,
+                worker->body_size, &length);
+            record(worker, now_ns() - start);
+            if (config->check && status == 200) {
+                worker->checked++;
+                if (length > worker->body_size
+                    || !stamp_check(worker->body, length, config->size)) {
+                    worker->torn++;
+                }
+            }
+        }
+        worker->statuses[status > 0 && status < MAX_STATUS ? status : 0]++;
+    }
+    client_close(&worker->client);
+    return NULL;
+}
+
+// Writes version 0 of every file, so that GETs find them from the start
+static bool prefill(const config_t *config) {
+    client_t client;
+    client_init(&client, &config->addr, config->keep_alive);
+    char *body = checked_malloc(config->size);
+    stamp_fill(body, config->size, 0xffff, 0);
+    bool ok = true;
+    for (int i = 0; i < config->files && ok; i++) {
+        char uri[32];
+        snprintf(uri, sizeof(uri), URI_FORMAT, i);
+        int status = client_put(&client, uri, body, stamp_size(config->size, 0));
+        if (status != 200 && status != 201) {
+            if (status == 0) {
+                fprintf(stderr, "Could not create /%s: no response\n", uri);
+            } else {
+                fprintf(stderr, "Could not create /%s: status %d\n", uri, status);
+            }
+            ok = false;
+        }
+    }
+    client_close(&client);
+    free(body);
+    return ok;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+// The nearest-rank percentile q of n sorted values
+static double percentile_ms(const uint64_t *sorted, size_t n, double q) {
+    size_t rank = (size_t) (q * n + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[(rank > n ? n : rank) - 1] / 1e6;
+}
+
+static void report(const config_t *config, worker_t *workers, double elapsed) {
+    size_t total = 0;
+    uint64_t statuses[MAX_STATUS] = { 0 };
+    uint64_t checked = 0, torn = 0;
+    for (int i = 0; i < config->threads; i++) {
+        total += workers[i].count;
+        for (int s = 0; s < MAX_STATUS; s++) {
+            statuses[s] += workers[i].statuses[s];
+        }
+        checked += workers[i].checked;
+        torn += workers[i].torn;
+    }
+
+    uint64_t *all = checked_malloc((total > 0 ? total : 1) * sizeof(uint64_t));
+    size_t n = 0;
+    for (int i = 0; i < config->threads; i++) {
+        memcpy(all + n, workers[i].latencies, workers[i].count * sizeof(uint64_t));
+        n += workers[i].count;
+    }
+    qsort(all, n, sizeof(uint64_t), compare_u64);
+
+    printf("threads %d, keep-alive %s, %.0f%% PUT, %d file%s (%s), %zu-byte bodies\n",
+        config->threads, config->keep_alive ? "on" : "off", config->put_percent, config->files,
+        config->files == 1 ? "" : "s", config->zipf_s > 0 ? "zipf" : "uniform", config->size);
+    printf("requests %zu in %.3f s: %.0f req/s\n", n, elapsed, n / elapsed);
+    for (int s = 1; s < MAX_STATUS; s++) {
+        if (statuses[s] > 0) {
+            printf("status %d: %llu\n", s, (unsigned long long) statuses[s]);
+        }
+    }
+    if (statuses[0] > 0) {
+        printf("no response: %llu\n", (unsigned long long) statuses[0]);
+    }
+    if (n > 0) {
+        printf("latency p50 %.3f ms  p99 %.3f ms  p99.9 %.3f ms  max %.3f ms\n",
+            percentile_ms(all, n, 0.50), percentile_ms(all, n, 0.99),
+            percentile_ms(all, n, 0.999), all[n - 1] / 1e6);
+    }
+    if (config->check) {
+        printf("torn %llu of %llu GETs checked\n", (unsigned long long) torn,
+            (unsigned long long) checked);
+    }
+    free(all);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr,
+        "Usage: %s [-t threads] [-n requests | -d seconds] [-k] [-p put_percent] [-f files]\n"
+        "       [-z zipf_s] [-s bytes] [-C] [-h host] <port>\n",
+        name);
+}
+
+int main(int argc, char **argv) {
+    config_t config = { .threads = 4, .requests = 10000, .put_percent = 10, .files = 100,
+        .size = 4096 };
+    const char *host = "127.0.0.1";
+    bool put_given = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:d:kp:f:z:s:Ch:")) != -1) {
+        switch (opt) {
+        case 't': config.threads = atoi(optarg); break;
+        case 'n':
+            config.requests = strtoull(optarg, NULL, 10);
+            config.seconds = 0;
+            break;
+        case 'd':
+            config.seconds = atof(optarg);
+            config.requests = 0;
+            break;
+        case 'k': config.keep_alive = true; break;
+        case 'p':
+            config.put_percent = atof(optarg);
+            put_given = true;
+            break;
+        case 'f': config.files = atoi(optarg); break;
+        case 'z': config.zipf_s = atof(optarg); break;
+        case 's': config.size = strtoull(optarg, NULL, 10); break;
+        case 'C': config.check = true; break;
+        case 'h': host = optarg; break;
+        default: usage(argv[0]); return EXIT_FAILURE;
+        }
+    }
+    if (optind >= argc || config.threads < 1 || config.files < 1 || config.zipf_s < 0
+        || config.put_percent < 0 || config.put_percent > 100 || config.size < STAMP_LENGTH
+        || (config.requests == 0 && config.seconds <= 0)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    int port = atoi(argv[optind]);
+    if (port < 1 || port > 65535 || !client_resolve(host, port, &config.addr)) {
+        fprintf(stderr, "Invalid host or port\n");
+        return EXIT_FAILURE;
+    }
+
+    // The check races readers against writers on a single file
+    if (config.check) {
+        config.files = 1;
+        if (!put_given) {
+            config.put_percent = 50;
+        }
+    }
+    zipf_init(&config.zipf, config.files, config.zipf_s);
+    // Without the files GETs just see 404s, which still load the server;
+    // the check has nothing to compare against, though
+    if (!prefill(&config) && config.check) {
+        return EXIT_FAILURE;
+    }
+
+    worker_t *workers = calloc(config.threads, sizeof(worker_t));
+    if (workers == NULL) {
+        fprintf(stderr, "Error allocating memory for the workers\n");
+        return EXIT_FAILURE;
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < config.threads; i++) {
+        worker_t *worker = &workers[i];
+        worker->id = i;
+        worker->config = &config;
+        worker->quota = config.requests / config.threads
+                        + ((uint64_t) i < config.requests % config.threads);
+        worker->deadline = start + (uint64_t) (config.seconds * 1e9);
+        client_init(&worker->client, &config.addr, config.keep_alive);
+        rng_seed(&worker->rng, (uint64_t) i);
+        // Room for the largest version, and a byte more to notice a longer body
+        worker->body_size = stamp_size(config.size, 3) + 1;
+        worker->body = checked_malloc(worker->body_size);
+        if (pthread_create(&worker->thread, NULL, worker_run, worker) != 0) {
+            fprintf(stderr, "Could not start thread %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    uint64_t torn = 0;
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        torn += workers[i].torn;
+    }
+    report(&config, workers, (now_ns() - start) / 1e9);
+
+    for (int i = 0; i < config.threads; i++) {
+        free(workers[i].latencies);
+        free(workers[i].body);
+    }
+    free(workers);
+    zipf_free(&config.zipf);
+    return torn > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "workload.h"
+
+void rng_seed(rng_t *rng, uint64_t seed) {
+    // splitmix64, so that nearby seeds give unrelated streams; never 0
+    uint64_t z = seed + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    rng->state = (z ^ (z >> 31)) | 1;
+}
+
+uint64_t rng_next(rng_t *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return rng->state * 0x2545f4914f6cdd1dull;
+}
+
+double rng_uniform(rng_t *rng) {
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0); // 53 bits
+}
+
+void zipf_init(zipf_t *zipf, int n, double s) {
+    zipf->n = n;
+    zipf->cdf = malloc(n * sizeof(double));
+    if (zipf->cdf == NULL) {
+        fprintf(stderr, "Error allocating memory for the URI distribution\n");
+        exit(EXIT_FAILURE);
+    }
+    double total = 0;
+    for (int i = 0; i < n; i++) {
+        total += 1.0 / pow(i + 1, s);
+        zipf->cdf[i] = total;
+    }
+    for (int i = 0; i < n; i++) {
+        zipf->cdf[i] /= total;
+    }
+}
+
+void zipf_free(zipf_t *zipf) {
+    free(zipf->cdf);
+    zipf->cdf = NULL;
+}
+
+int zipf_pick(const zipf_t *zipf, rng_t *rng) {
+    // The first file whose cumulative probability exceeds u
+    double u = rng_uniform(rng);
+    int low = 0, high = zipf->n - 1;
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (zipf->cdf[mid] > u) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+size_t stamp_size(size_t base, uint64_t seq) {
+    return base + (seq % 4) * SIZE_STEP;
+}
+
+void stamp_fill(char *body, size_t size, unsigned writer, uint64_t seq) {
+    char stamp[STAMP_LENGTH + 1];
+    snprintf(stamp, sizeof(stamp), "%04x:%010llx\n", writer & 0xffff,
+        (unsigned long long) (seq & 0xffffffffffull));
+    for (size_t i = 0; i < size; i += STAMP_LENGTH) {
+        memcpy(body + i, stamp, size - i < STAMP_LENGTH ? size - i : STAMP_LENGTH);
+    }
+}
+
+bool stamp_check(const char *body, size_t size, size_t base) {
+    unsigned writer;
+    unsigned long long seq;
+    char stamp[STAMP_LENGTH + 1];
+    if (size < STAMP_LENGTH) {
+        return false;
+    }
+    memcpy(stamp, body, STAMP_LENGTH);
+    stamp[STAMP_LENGTH] = '\0';
+    if (sscanf(stamp, "%4x:%10llx\n", &writer, &seq) != 2 || size != stamp_size(base, seq)) {
+        return false;
+    }
+    for (size_t i = 0; i < size; i += STAMP_LENGTH) {
+        size_t n = size - i < STAMP_LENGTH ? size - i : STAMP_LENGTH;
+        if (memcmp(body + i, stamp, n) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+/**
+ * @File workload.h
+ *
+ * What the load generator asks for: which URI each request goes to, drawn
+ * uniformly or from a Zipfian distribution so that a few files are hot,
+ * and the bodies it PUTs.  Every body is stamped with its writer and a
+ * sequence number throughout, so a GET that returns anything other than
+ * one whole version of a file is caught.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// One stamp, repeated to fill a body: "wwww:ssssssssss\n"
+#define STAMP_LENGTH 16
+
+// Sizes in the correctness check differ by this much between versions,
+// so a GET mixing two of them also has the wrong length
+#define SIZE_STEP 1000
+
+/** @struct rng_t
+ *  @brief A xorshift64* generator; one per thread.
+ */
+typedef struct {
+    uint64_t state;
+} rng_t;
+
+/** @struct zipf_t
+ *  @brief Cumulative probabilities of picking file 0, 1, ... n - 1.
+ */
+typedef struct {
+    int n;
+    double *cdf;
+} zipf_t;
+
+/** @brief Seeds rng; any seed works.
+ */
+void rng_seed(rng_t *rng, uint64_t seed);
+
+/** @brief The next 64 random bits.
+ */
+uint64_t rng_next(rng_t *rng);
+
+/** @brief A random number in [0, 1).
+ */
+double rng_uniform(rng_t *rng);
+
+/** @brief Sets up picking among n files with probability proportional to
+ *         1 / rank^s; s = 0 picks uniformly.
+ */
+void zipf_init(zipf_t *zipf, int n, double s);
+
+/** @brief Frees what zipf_init allocated.
+ */
+void zipf_free(zipf_t *zipf);
+
+/** @brief Picks a file; 0 is the hottest.
+ */
+int zipf_pick(const zipf_t *zipf, rng_t *rng);
+
+/** @brief The size of writer's version seq in the correctness check,
+ *         one of four sizes from base up.
+ */
+size_t stamp_size(size_t base, uint64_t seq);
+
+/** @brief Fills size bytes of body with writer's version seq.
+ */
+void stamp_fill(char *body, size_t size, unsigned writer, uint64_t seq);
+
+/** @brief Whether body holds exactly one whole version, as written by
+ *         stamp_fill with the size stamp_size gives it.
+ */
+bool stamp_check(const char *body, size_t size, size_t base);